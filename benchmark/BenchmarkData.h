@@ -0,0 +1,43 @@
+#pragma once
+#include <SymSpell.h>
+
+// Test data for the benchmarks, derived from the English frequency dictionary.
+
+#define DEFAULT_BENCHMARK_DICTIONARY "../data/frequency_dictionary_en_82_765.txt"
+
+// words of a word/frequency count dictionary file, in file order
+inline vector<xstring> LoadDictionaryWords(const string& path)
+{
+	vector<xstring> words;
+	xifstream corpus(path);
+	xstring word;
+	int64_t count;
+	while (corpus >> word >> count) words.push_back(word);
+	return words;
+}
+
+// misspell some of the dictionary words, with a skewed distribution so that frequent tokens repeat
+inline vector<xstring> MakeTokens(const vector<xstring>& dictionaryWords, size_t count)
+{
+	vector<xstring> tokens;
+	tokens.reserve(count);
+	uint64_t random = 88172645463325252ULL;
+	auto next = [&random]() { random ^= random << 13; random ^= random >> 7; random ^= random << 17; return random; };
+	for (size_t i = 0; i < count; i++)
+	{
+		// the square of a uniform number favors the front of the dictionary, which is ordered by frequency
+		double u = (double)(next() % 1000000) / 1000000.0;
+		xstring token = dictionaryWords[(size_t)(u * u * dictionaryWords.size())];
+		size_t position = next() % token.size();
+		switch (next() % 4)
+		{
+		case 0: break;
+		case 1: token.erase(position, 1); break;
+		case 2: token.insert(position, 1, (xchar)('a' + next() % 26)); break;
+		case 3: if (position + 1 < token.size()) swap(token[position], token[position + 1]); break;
+		}
+		if (token.empty()) token = dictionaryWords[0];
+		tokens.push_back(token);
+	}
+	return tokens;
+}
@@ -0,0 +1,144 @@
+// DeltaReloadBenchmark.cpp : time to reload a changed dictionary with LiveSymSpell::ApplyDelta compared to loading
+// the whole new dictionary file, and a check that lookups then give the same suggestions.
+// usage: symspell_delta_bench [dictionary path] [changed counts] [new words] [removed words]
+#include "BenchmarkData.h"
+#include "LiveSymSpell.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#ifndef UNICODE_SUPPORT
+
+// all suggestions of the tokens, to compare dictionaries
+static vector<vector<SuggestItem>> LookupAll(const SymSpell& symSpell, const vector<xstring>& tokens)
+{
+	vector<vector<SuggestItem>> results;
+	for (const xstring& token : tokens) results.push_back(symSpell.Lookup(token, All));
+	return results;
+}
+
+static bool Same(const vector<vector<SuggestItem>>& a, const vector<vector<SuggestItem>>& b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].size() != b[i].size()) return false;
+		for (size_t j = 0; j < a[i].size(); j++)
+		{
+			if (a[i][j].term != b[i][j].term || a[i][j].distance != b[i][j].distance || a[i][j].count != b[i][j].count) return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	size_t changedCount = argc > 2 ? (size_t)atoll(argv[2]) : 5000;
+	size_t newCount = argc > 3 ? (size_t)atoll(argv[3]) : 500;
+	size_t removedCount = argc > 4 ? (size_t)atoll(argv[4]) : 300;
+
+	// the words and counts of the dictionary, as the new version of the dictionary and the delta to it
+	vector<pair<xstring, int64_t>> entries;
+	{
+		xifstream corpus(corpus_path);
+		xstring word;
+		int64_t count;
+		while (corpus >> word >> count) entries.push_back(pair<xstring, int64_t>(word, count));
+	}
+	if (entries.empty())
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+	string deltaPath = corpus_path + ".delta.tmp", updatedPath = corpus_path + ".updated.tmp";
+	{
+		ofstream delta(deltaPath), updated(updatedPath);
+		uint64_t random = 88172645463325252ULL;
+		auto next = [&random]() { random ^= random << 13; random ^= random >> 7; random ^= random << 17; return random; };
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			// the most frequent words have counts above 2^31, which every operation must keep exactly
+			if (i < 3)
+			{
+				switch (i)
+				{
+				case 0: entries[i].second += 5; delta << "+ " << entries[i].first << " 5\n"; break;
+				case 1: entries[i].second -= 3; delta << "- " << entries[i].first << " 3\n"; break;
+				case 2: entries[i].second += (int64_t)1 << 32; delta << "= " << entries[i].first << " " << entries[i].second << "\n"; break;
+				}
+				updated << entries[i].first << " " << entries[i].second << "\n";
+				continue;
+			}
+			uint64_t pick = next() % entries.size();
+			if (pick < removedCount)
+			{
+				delta << "- " << entries[i].first << "\n";
+				continue;
+			}
+			if (pick < removedCount + changedCount)
+			{
+				entries[i].second = entries[i].second / 2 + (int64_t)(next() % entries[i].second) + 1;
+				delta << "= " << entries[i].first << " " << entries[i].second << "\n";
+			}
+			updated << entries[i].first << " " << entries[i].second << "\n";
+		}
+		for (size_t i = 0; i < newCount; i++)
+		{
+			string word;
+			for (size_t j = 4 + next() % 8; j > 0; j--) word += (char)('a' + next() % 26);
+			word += "new" + to_string(i);
+			int64_t count = 1 + next() % 100000;
+			delta << "+ " << word << " " << count << "\n";
+			updated << word << " " << count << "\n";
+		}
+	}
+
+	unique_ptr<SymSpell> initial(new SymSpell(82765, 2, 7));
+	initial->LoadDictionary(corpus_path, 0, 1, XL(' '));
+	LiveSymSpell live(move(initial));
+	DeltaReload reload = live.ApplyDelta(deltaPath);
+
+	auto start = chrono::steady_clock::now();
+	SymSpell rebuilt(82765, 2, 7);
+	rebuilt.LoadDictionary(updatedPath, 0, 1, XL(' '));
+	double rebuildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	remove(deltaPath.c_str());
+	remove(updatedPath.c_str());
+
+	cout << "added: " << reload.changes.added << ", updated: " << reload.changes.updated << ", removed: " << reload.changes.removed
+		<< ", errors: " << reload.errors.size() << endl;
+	cout << "delta reload ms: copy " << reload.copySeconds * 1000 << ", apply " << reload.applySeconds * 1000 << ", swap " << reload.swapSeconds * 1000
+		<< ", total " << (reload.copySeconds + reload.applySeconds + reload.swapSeconds) * 1000 << endl;
+	cout << "full load ms: " << rebuildSeconds * 1000 << endl;
+
+	LiveSymSpell::Pin symSpell = live.Read();
+	for (size_t i = 0; i < 3 && i < entries.size(); i++)
+	{
+		vector<SuggestItem> found = symSpell->Lookup(entries[i].first, Top, 0);
+		if (found.empty() || found[0].count != entries[i].second)
+		{
+			cerr << "count of " << entries[i].first << " is " << (found.empty() ? 0 : found[0].count) << " instead of " << entries[i].second << endl;
+			return 1;
+		}
+	}
+	vector<xstring> tokens = MakeTokens(LoadDictionaryWords(corpus_path), 20000);
+	if (!reload.loaded || !reload.errors.empty() || symSpell->WordCount() != rebuilt.WordCount()
+		|| !Same(LookupAll(*symSpell, tokens), LookupAll(rebuilt, tokens)))
+	{
+		cerr << "suggestions after the delta differ from the updated dictionary" << endl;
+		return 1;
+	}
+	cout << "suggestions match the updated dictionary" << endl;
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,93 @@
+// FrozenWordsBenchmark.cpp : memory of the word table, and time of exact matches, Lookup and WordSegmentation,
+// with hash slots compared to the minimal perfect hash of SymSpell::Freeze.
+// usage: symspell_freeze_bench [dictionary path] [number of tokens]
+#include "BenchmarkData.h"
+
+#include <chrono>
+#include <iostream>
+
+#ifndef UNICODE_SUPPORT
+
+// nanoseconds per call of query over all inputs, the best of a few runs, and the sum of its results, to compare the runs
+static double Run(const vector<xstring>& inputs, const function<size_t(const xstring&)>& query, size_t& results)
+{
+	double best = 0;
+	for (int run = 0; run < 5; run++)
+	{
+		results = 0;
+		auto start = chrono::steady_clock::now();
+		for (const xstring& input : inputs) results += query(input);
+		double time = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / inputs.size();
+		if (run == 0 || time < best) best = time;
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	size_t tokenCount = argc > 2 ? (size_t)atoll(argv[2]) : 100000;
+
+	SymSpell symSpell(82765, 2, 7);
+	if (!symSpell.LoadDictionary(corpus_path, 0, 1, XL(' ')))
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+	vector<xstring> words = LoadDictionaryWords(corpus_path);
+	vector<xstring> tokens = MakeTokens(words, tokenCount);
+	// segmentation inputs: runs of tokens without spaces
+	vector<xstring> texts;
+	for (size_t i = 0; i + 6 <= tokens.size() && texts.size() < tokens.size() / 100; i += 6)
+	{
+		texts.push_back(tokens[i] + tokens[i + 1] + tokens[i + 2] + tokens[i + 3] + tokens[i + 4] + tokens[i + 5]);
+	}
+
+	struct Query
+	{
+		const char* name;
+		const vector<xstring>& inputs;
+		function<size_t(const xstring&)> run;
+	};
+	Query queries[] = {
+		{ "exact match", tokens, [&](const xstring& token) { return symSpell.Lookup(token, Top, 0).size(); } },
+		{ "Lookup Closest", tokens, [&](const xstring& token) { return symSpell.Lookup(token, Closest).size(); } },
+		{ "WordSegmentation", texts, [&](const xstring& text) { return (size_t)symSpell.WordSegmentation(text).getDistance(); } }
+	};
+
+	size_t slotBytes = symSpell.MemoryReport().words;
+	vector<double> slotTimes;
+	vector<size_t> slotResults;
+	for (Query& query : queries)
+	{
+		size_t results;
+		slotTimes.push_back(Run(query.inputs, query.run, results));
+		slotResults.push_back(results);
+	}
+	symSpell.Freeze();
+	size_t frozenBytes = symSpell.MemoryReport().words;
+
+	cout << "words: " << symSpell.WordCount() << ", word table bytes: hash slots " << slotBytes << ", frozen " << frozenBytes << endl;
+	cout << "query\thash slots ns\tfrozen ns\tspeedup" << endl;
+	for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+	{
+		size_t results;
+		double frozenTime = Run(queries[i].inputs, queries[i].run, results);
+		if (results != slotResults[i])
+		{
+			cerr << "results of " << queries[i].name << " differ" << endl;
+			return 1;
+		}
+		cout << queries[i].name << "\t" << (int64_t)slotTimes[i] << "\t" << (int64_t)frozenTime << "\t" << slotTimes[i] / frozenTime << endl;
+	}
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
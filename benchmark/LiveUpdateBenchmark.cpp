@@ -0,0 +1,121 @@
+// LiveUpdateBenchmark.cpp : Lookup latency of reader threads while a writer keeps adding words, with a LiveSymSpell
+// compared to a SymSpell behind a reader/writer lock.
+// usage: symspell_live_bench [dictionary path] [lookups per reader] [reader threads] [words per update]
+#include "BenchmarkData.h"
+#include "LiveSymSpell.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <shared_mutex>
+
+#ifndef UNICODE_SUPPORT
+
+// latencies of the lookups of all readers, in nanoseconds
+static vector<double> RunReaders(int readerCount, size_t lookups, const vector<xstring>& tokens, const function<size_t(const xstring&)>& lookup)
+{
+	vector<vector<double>> latencies(readerCount);
+	vector<thread> readers;
+	for (int r = 0; r < readerCount; r++)
+	{
+		readers.emplace_back([&, r]()
+		{
+			latencies[r].reserve(lookups);
+			for (size_t i = 0; i < lookups; i++)
+			{
+				auto start = chrono::steady_clock::now();
+				lookup(tokens[(i * readerCount + r) % tokens.size()]);
+				latencies[r].push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+			}
+		});
+	}
+	for (thread& reader : readers) reader.join();
+	vector<double> all;
+	for (auto& reader : latencies) all.insert(all.end(), reader.begin(), reader.end());
+	sort(all.begin(), all.end());
+	return all;
+}
+
+// runs the readers while update is called in a loop, if given, and writes a line of latency percentiles
+static void Measure(const char* name, int readerCount, size_t lookups, const vector<xstring>& tokens,
+	const function<size_t(const xstring&)>& lookup, const function<void()>& update)
+{
+	atomic<bool> done{ false };
+	size_t updates = 0;
+	thread writer;
+	if (update) writer = thread([&]() { while (!done.load()) { update(); updates++; } });
+	vector<double> latencies = RunReaders(readerCount, lookups, tokens, lookup);
+	done = true;
+	if (writer.joinable()) writer.join();
+	auto percentile = [&](double p) { return (int64_t)latencies[min((size_t)(p * latencies.size()), latencies.size() - 1)]; };
+	cout << name << "\t" << updates << "\t" << percentile(0.5) << "\t" << percentile(0.99) << "\t" << percentile(0.999) << "\t" << (int64_t)latencies.back() << endl;
+}
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	size_t lookups = argc > 2 ? (size_t)atoll(argv[2]) : 20000;
+	int readerCount = argc > 3 ? atoi(argv[3]) : max(1, (int)thread::hardware_concurrency() - 1);
+	size_t wordsPerUpdate = argc > 4 ? (size_t)atoll(argv[4]) : 100;
+
+	unique_ptr<SymSpell> initial(new SymSpell(82765, 2, 7));
+	if (!initial->LoadDictionary(corpus_path, 0, 1, XL(' ')))
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+	SymSpell locked(*initial);
+	LiveSymSpell live(move(initial));
+	vector<xstring> tokens = MakeTokens(LoadDictionaryWords(corpus_path), 100000);
+
+	size_t added = 0;
+	auto addWords = [&](SymSpell& symSpell)
+	{
+		for (size_t i = 0; i < wordsPerUpdate; i++, added++) symSpell.CreateDictionaryEntry(XL("live") + to_string(added), 1, nullptr);
+	};
+	auto liveLookup = [&](const xstring& token)
+	{
+		LiveSymSpell::Pin symSpell = live.Read();
+		return symSpell->Lookup(token, Top).size();
+	};
+	shared_mutex lock;
+	auto lockedLookup = [&](const xstring& token)
+	{
+		shared_lock<shared_mutex> guard(lock);
+		return locked.Lookup(token, Top).size();
+	};
+
+	cout << "readers: " << readerCount << ", lookups per reader: " << lookups << ", words per update: " << wordsPerUpdate << endl;
+	cout << "dictionary\tupdates\tp50 ns\tp99 ns\tp999 ns\tmax ns" << endl;
+	Measure("live, no updates", readerCount, lookups, tokens, liveLookup, nullptr);
+	Measure("live, updates", readerCount, lookups, tokens, liveLookup, [&]() { live.Update(addWords); });
+	Measure("locked, no updates", readerCount, lookups, tokens, lockedLookup, nullptr);
+	Measure("locked, updates", readerCount, lookups, tokens, lockedLookup, [&]()
+	{
+		unique_lock<shared_mutex> guard(lock);
+		addWords(locked);
+	});
+	size_t retired = live.Reclaim();
+	if (retired != 0)
+	{
+		cerr << retired << " replaced generations were not freed" << endl;
+		return 1;
+	}
+	// short lived threads, as in a thread pool that replaces its threads, reuse the read states of exited ones
+	for (int i = 0; i < 1000; i++) thread([&]() { liveLookup(tokens[i % tokens.size()]); }).join();
+	if (live.ReaderSlots() > (size_t)readerCount)
+	{
+		cerr << live.ReaderSlots() << " read states for " << readerCount << " concurrent readers" << endl;
+		return 1;
+	}
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,77 @@
+// LookupAllocationBenchmark.cpp : heap allocations and time per SymSpell::Lookup, with and without a reused LookupContext.
+// usage: symspell_alloc_bench [dictionary path] [number of tokens]
+#include "BenchmarkData.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+static atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	void* p = malloc(size == 0 ? 1 : size);
+	if (p == nullptr) throw bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+#ifndef UNICODE_SUPPORT
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	size_t tokenCount = argc > 2 ? (size_t)atoll(argv[2]) : 100000;
+
+	SymSpell symSpell(82765, 2, 7);
+	if (!symSpell.LoadDictionary(corpus_path, 0, 1, XL(' ')))
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+	vector<xstring> tokens = MakeTokens(LoadDictionaryWords(corpus_path), tokenCount);
+
+	const char* names[] = { "Top", "Closest", "All" };
+	cout << "tokens: " << tokens.size() << endl;
+	cout << "verbosity\tapi\tallocations/lookup\tns/lookup" << endl;
+	for (int verbosity = Top; verbosity <= All; verbosity++)
+	{
+		// the vector returning overload allocates the result
+		uint64_t before = allocations.load();
+		auto start = chrono::steady_clock::now();
+		size_t found = 0;
+		for (const xstring& token : tokens) found += symSpell.Lookup(token, (Verbosity)verbosity, 2).size();
+		double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+		cout << names[verbosity] << "\tvector\t" << (double)(allocations.load() - before) / tokens.size() << "\t" << (int64_t)(ns / tokens.size()) << endl;
+
+		// with a context and a result vector reused across lookups, once their buffers have grown
+		LookupContext context;
+		vector<SuggestItem> suggestions;
+		for (const xstring& token : tokens) symSpell.Lookup(token, (Verbosity)verbosity, 2, false, context, suggestions);
+		before = allocations.load();
+		start = chrono::steady_clock::now();
+		for (const xstring& token : tokens)
+		{
+			symSpell.Lookup(token, (Verbosity)verbosity, 2, false, context, suggestions);
+			found += suggestions.size();
+		}
+		ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+		cout << names[verbosity] << "\tcontext\t" << (double)(allocations.load() - before) / tokens.size() << "\t" << (int64_t)(ns / tokens.size()) << endl;
+		if (found == 0) cerr << "no suggestions found" << endl;
+	}
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
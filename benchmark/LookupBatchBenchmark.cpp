@@ -0,0 +1,52 @@
+// LookupBatchBenchmark.cpp : throughput of SymSpell::LookupBatch for an increasing number of threads.
+// usage: symspell_batch_bench [dictionary path] [number of tokens]
+#include "BenchmarkData.h"
+
+#include <chrono>
+#include <iostream>
+
+#ifndef UNICODE_SUPPORT
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	size_t tokenCount = argc > 2 ? (size_t)atoll(argv[2]) : 200000;
+
+	SymSpell symSpell(82765, 2, 7);
+	if (!symSpell.LoadDictionary(corpus_path, 0, 1, XL(' ')))
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+
+	vector<xstring> tokens = MakeTokens(LoadDictionaryWords(corpus_path), tokenCount);
+	vector<xstring_view> inputs(tokens.begin(), tokens.end());
+	vector<vector<SuggestItem>> results;
+
+	int maxThreads = max(1, (int)thread::hardware_concurrency());
+	vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2) threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	cout << "tokens: " << inputs.size() << ", hardware threads: " << maxThreads << endl;
+	cout << "threads\tms\ttokens/s\tspeedup" << endl;
+	double baseline = 0;
+	for (int threads : threadCounts)
+	{
+		auto start = chrono::steady_clock::now();
+		symSpell.LookupBatch(inputs, Verbosity::Closest, 2, threads, results);
+		double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		if (baseline == 0) baseline = ms;
+		cout << threads << "\t" << (int64_t)ms << "\t" << (int64_t)(inputs.size() / ms * 1000) << "\t" << baseline / ms << endl;
+	}
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,78 @@
+// LookupEngineBenchmark.cpp : time per SymSpell::Lookup of the specialized engines compared to the generic one.
+// usage: symspell_engine_bench [dictionary path] [number of tokens]
+#include "BenchmarkData.h"
+
+#include <chrono>
+#include <iostream>
+
+#ifndef UNICODE_SUPPORT
+
+// nanoseconds per lookup over all tokens, and the suggestions found, to compare the engines
+static double Run(const SymSpell& symSpell, const vector<xstring>& tokens, Verbosity verbosity, vector<vector<SuggestItem>>& results)
+{
+	LookupContext context;
+	results.resize(tokens.size());
+	for (size_t i = 0; i < tokens.size(); i++) symSpell.Lookup(tokens[i], verbosity, symSpell.MaxDictionaryEditDistance(), false, context, results[i]);
+	auto start = chrono::steady_clock::now();
+	for (size_t i = 0; i < tokens.size(); i++) symSpell.Lookup(tokens[i], verbosity, symSpell.MaxDictionaryEditDistance(), false, context, results[i]);
+	return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / tokens.size();
+}
+
+static bool Same(const vector<vector<SuggestItem>>& a, const vector<vector<SuggestItem>>& b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].size() != b[i].size()) return false;
+		for (size_t j = 0; j < a[i].size(); j++)
+		{
+			if (a[i][j].term != b[i][j].term || a[i][j].distance != b[i][j].distance || a[i][j].count != b[i][j].count) return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	size_t tokenCount = argc > 2 ? (size_t)atoll(argv[2]) : 100000;
+
+	vector<xstring> tokens = MakeTokens(LoadDictionaryWords(corpus_path), tokenCount);
+	const int parameters[][2] = { { 1, 5 }, { 2, 7 } };
+	const char* names[] = { "Top", "Closest", "All" };
+	cout << "tokens: " << tokens.size() << endl;
+	cout << "edit distance\tprefix\tverbosity\tgeneric ns/lookup\tspecialized ns/lookup\tspeedup" << endl;
+	for (auto& parameter : parameters)
+	{
+		SymSpell symSpell(82765, parameter[0], parameter[1]);
+		if (!symSpell.LoadDictionary(corpus_path, 0, 1, XL(' ')))
+		{
+			cerr << "Dictionary not found: " << corpus_path << endl;
+			return 1;
+		}
+		for (int verbosity = Top; verbosity <= All; verbosity++)
+		{
+			vector<vector<SuggestItem>> generic, specialized;
+			symSpell.SetSpecializedLookup(false);
+			double genericTime = Run(symSpell, tokens, (Verbosity)verbosity, generic);
+			symSpell.SetSpecializedLookup(true);
+			double specializedTime = Run(symSpell, tokens, (Verbosity)verbosity, specialized);
+			if (!Same(generic, specialized))
+			{
+				cerr << "suggestions differ" << endl;
+				return 1;
+			}
+			cout << parameter[0] << "\t" << parameter[1] << "\t" << names[verbosity] << "\t" << (int64_t)genericTime << "\t" << (int64_t)specializedTime << "\t" << genericTime / specializedTime << endl;
+		}
+	}
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
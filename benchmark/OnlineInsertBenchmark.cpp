@@ -0,0 +1,168 @@
+// OnlineInsertBenchmark.cpp : latency of single unstaged CreateDictionaryEntry and RemoveDictionaryEntry calls
+// as the dictionary grows, and a check that lookups then match a dictionary built with staging, also after
+// words were removed and added many times.
+// usage: symspell_insert_bench [dictionary path] [number of inserted words] [batch size]
+#include "BenchmarkData.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#ifndef UNICODE_SUPPORT
+
+// made up product names, which are not in the dictionary
+static vector<xstring> MakeNames(size_t count)
+{
+	vector<xstring> names;
+	names.reserve(count);
+	uint64_t random = 88172645463325252ULL;
+	auto next = [&random]() { random ^= random << 13; random ^= random >> 7; random ^= random << 17; return random; };
+	for (size_t i = 0; i < count; i++)
+	{
+		xstring name;
+		size_t length = 4 + next() % 11;
+		for (size_t j = 0; j < length; j++) name += (xchar)('a' + next() % 26);
+		name += XL('x') + to_string(i);
+		names.push_back(name);
+	}
+	return names;
+}
+
+// writes the mean and 99th percentile of the latencies of a batch, in nanoseconds
+static void Report(const char* operation, size_t words, vector<double>& latencies)
+{
+	double sum = 0;
+	for (double latency : latencies) sum += latency;
+	sort(latencies.begin(), latencies.end());
+	cout << operation << "\t" << words << "\t" << (int64_t)(sum / latencies.size()) << "\t" << (int64_t)latencies[latencies.size() * 99 / 100] << endl;
+}
+
+// all suggestions of the tokens, to compare dictionaries
+static vector<vector<SuggestItem>> LookupAll(const SymSpell& symSpell, const vector<xstring>& tokens)
+{
+	vector<vector<SuggestItem>> results;
+	for (const xstring& token : tokens) results.push_back(symSpell.Lookup(token, All));
+	return results;
+}
+
+static bool Same(const vector<vector<SuggestItem>>& a, const vector<vector<SuggestItem>>& b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].size() != b[i].size()) return false;
+		for (size_t j = 0; j < a[i].size(); j++)
+		{
+			if (a[i][j].term != b[i][j].term || a[i][j].distance != b[i][j].distance || a[i][j].count != b[i][j].count) return false;
+		}
+	}
+	return true;
+}
+
+// the dictionary plus the names from first on, added with staging
+static bool Rebuild(SymSpell& symSpell, const string& corpus_path, const vector<xstring>& names, size_t first)
+{
+	if (!symSpell.LoadDictionary(corpus_path, 0, 1, XL(' '))) return false;
+	SuggestionStage staging(16384);
+	for (size_t i = first; i < names.size(); i++) symSpell.CreateDictionaryEntry(names[i], 1, &staging);
+	symSpell.CommitStaged(&staging);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	size_t nameCount = argc > 2 ? (size_t)atoll(argv[2]) : 200000;
+	size_t batchSize = argc > 3 ? (size_t)atoll(argv[3]) : 20000;
+
+	SymSpell symSpell(82765, 2, 7);
+	if (!symSpell.LoadDictionary(corpus_path, 0, 1, XL(' ')))
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+	vector<xstring> dictionaryWords = LoadDictionaryWords(corpus_path);
+
+	// the most frequent words have counts above 2^31, which an update must keep exactly
+	int64_t topCount = symSpell.Lookup(dictionaryWords[0], Top, 0)[0].count;
+	symSpell.CreateDictionaryEntry(dictionaryWords[0], 1, nullptr);
+	int64_t increased = symSpell.Lookup(dictionaryWords[0], Top, 0)[0].count;
+	symSpell.RemoveDictionaryEntry(dictionaryWords[0], 1);
+	int64_t restored = symSpell.Lookup(dictionaryWords[0], Top, 0)[0].count;
+	if (increased != topCount + 1 || restored != topCount)
+	{
+		cerr << "count of " << dictionaryWords[0] << " is " << increased << " after adding 1 to " << topCount << endl;
+		return 1;
+	}
+
+	vector<xstring> names = MakeNames(nameCount);
+	vector<xstring> tokens = MakeTokens(dictionaryWords, 2000);
+	vector<xstring> nameTokens = MakeTokens(names, 2000);
+	tokens.insert(tokens.end(), nameTokens.begin(), nameTokens.end());
+
+	cout << "operation\twords\tmean ns\tp99 ns" << endl;
+	vector<double> latencies;
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		auto start = chrono::steady_clock::now();
+		symSpell.CreateDictionaryEntry(names[i], 1, nullptr);
+		latencies.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+		if (latencies.size() == batchSize || i + 1 == names.size())
+		{
+			Report("insert", symSpell.WordCount(), latencies);
+			latencies.clear();
+		}
+	}
+	SymSpell staged(82765, 2, 7);
+	if (!Rebuild(staged, corpus_path, names, 0) || !Same(LookupAll(symSpell, tokens), LookupAll(staged, tokens)))
+	{
+		cerr << "suggestions after insertion differ" << endl;
+		return 1;
+	}
+
+	// remove the older half of the names
+	for (size_t i = 0; i < names.size() / 2; i++)
+	{
+		auto start = chrono::steady_clock::now();
+		symSpell.RemoveDictionaryEntry(names[i]);
+		latencies.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+		if (latencies.size() == batchSize || i + 1 == names.size() / 2)
+		{
+			Report("remove", symSpell.WordCount(), latencies);
+			latencies.clear();
+		}
+	}
+	// churn: remove and add the remaining names again, which must not grow the word table, as the ids and
+	// chars of removed words are reclaimed
+	size_t churnedBytes = 0;
+	for (int round = 0; round < 5; round++)
+	{
+		for (size_t i = names.size() / 2; i < names.size(); i++) symSpell.RemoveDictionaryEntry(names[i]);
+		for (size_t i = names.size() / 2; i < names.size(); i++) symSpell.CreateDictionaryEntry(names[i], 1, nullptr);
+		MemoryUsage memory = symSpell.MemoryReport();
+		cout << "churn	" << symSpell.WordCount() << "	words bytes " << memory.words << ", of removed words " << memory.removedWords << endl;
+		if (round == 0) churnedBytes = memory.words;
+		else if (memory.words > churnedBytes * 2)
+		{
+			cerr << "the word table grows with every removal and addition" << endl;
+			return 1;
+		}
+	}
+	SymSpell remaining(82765, 2, 7);
+	if (!Rebuild(remaining, corpus_path, names, names.size() / 2) || !Same(LookupAll(symSpell, tokens), LookupAll(remaining, tokens)))
+	{
+		cerr << "suggestions after removal differ" << endl;
+		return 1;
+	}
+	cout << "suggestions match a staged build" << endl;
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,164 @@
+// SnapshotBenchmark.cpp : time to load a dictionary file compared to opening a snapshot of it, and a check that
+// the snapshot gives the same suggestions, also of a frozen dictionary and after it was updated and saved over
+// while mapped, and that snapshots with inconsistent arrays are rejected.
+// usage: symspell_snapshot_bench [dictionary path] [snapshot path]
+#include "BenchmarkData.h"
+#include "Snapshot.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifndef UNICODE_SUPPORT
+
+// all suggestions of the tokens, to compare dictionaries
+static vector<vector<SuggestItem>> LookupAll(const SymSpell& symSpell, const vector<xstring>& tokens)
+{
+	vector<vector<SuggestItem>> results;
+	for (const xstring& token : tokens) results.push_back(symSpell.Lookup(token, All));
+	return results;
+}
+
+static bool Same(const vector<vector<SuggestItem>>& a, const vector<vector<SuggestItem>>& b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].size() != b[i].size()) return false;
+		for (size_t j = 0; j < a[i].size(); j++)
+		{
+			if (a[i][j].term != b[i][j].term || a[i][j].distance != b[i][j].distance || a[i][j].count != b[i][j].count) return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	string snapshot_path = argc > 2 ? argv[2] : corpus_path + ".snapshot.tmp";
+
+	auto start = chrono::steady_clock::now();
+	SymSpell loaded(82765, 2, 7);
+	if (!loaded.LoadDictionary(corpus_path, 0, 1, XL(' ')))
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+	double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (!loaded.SaveSnapshot(snapshot_path))
+	{
+		cerr << "snapshot could not be saved: " << snapshot_path << endl;
+		return 1;
+	}
+
+	start = chrono::steady_clock::now();
+	SymSpell mapped(82765, 2, 7);
+	bool opened = mapped.OpenSnapshot(snapshot_path);
+	double openSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cout << "load ms: " << loadSeconds * 1000 << ", open snapshot ms: " << openSeconds * 1000 << endl;
+
+	vector<xstring> tokens = MakeTokens(LoadDictionaryWords(corpus_path), 5000);
+	vector<vector<SuggestItem>> expected = LookupAll(loaded, tokens);
+	if (!opened || !Same(LookupAll(mapped, tokens), expected))
+	{
+		cerr << "suggestions of the snapshot differ" << endl;
+		return 1;
+	}
+	// a frozen dictionary keeps its words in the order of the perfect hash
+	{
+		SymSpell frozen(82765, 2, 7);
+		frozen.LoadDictionary(corpus_path, 0, 1, XL(' '));
+		frozen.Freeze();
+		string frozen_path = snapshot_path + ".frozen";
+		SymSpell mappedFrozen(82765, 2, 7);
+		bool same = frozen.SaveSnapshot(frozen_path) && mappedFrozen.OpenSnapshot(frozen_path) && Same(LookupAll(mappedFrozen, tokens), expected);
+		remove(frozen_path.c_str());
+		if (!same)
+		{
+			cerr << "suggestions of the snapshot of a frozen dictionary differ" << endl;
+			return 1;
+		}
+	}
+
+	// a copy with consistent checksum but inconsistent arrays must be rejected, or at least answer lookups
+	{
+		vector<char> file;
+		{
+			ifstream in(snapshot_path, ios::binary);
+			file.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+		}
+		string corrupted_path = snapshot_path + ".corrupted";
+		auto openCorrupted = [&](size_t position, uint32_t value)
+		{
+			vector<char> copy = file;
+			memcpy(copy.data() + position, &value, sizeof(value));
+			SnapshotHeader header;
+			memcpy(&header, copy.data(), sizeof(header));
+			SnapshotChecksum checksum;
+			checksum.Add(copy.data() + sizeof(header), header.payloadSize);
+			header.checksum = checksum.Value();
+			memcpy(copy.data(), &header, sizeof(header));
+			ofstream(corrupted_path, ios::binary).write(copy.data(), copy.size());
+			SymSpell corrupted(82765, 2, 7);
+			bool opened = corrupted.OpenSnapshot(corrupted_path);
+			if (opened) LookupAll(corrupted, vector<xstring>(tokens.begin(), tokens.begin() + 100));
+			return opened;
+		};
+		// the payload starts with the chars of the words, followed by their offsets; make the second offset point past the chars
+		uint64_t charCount;
+		memcpy(&charCount, file.data() + sizeof(SnapshotHeader), sizeof(charCount));
+		size_t secondOffset = sizeof(SnapshotHeader) + 8 + (size_t)((charCount * sizeof(xchar) + 7) & ~(uint64_t)7) + 8 + sizeof(uint32_t);
+		bool rejected = !openCorrupted(secondOffset, 0x7FFFFFFF);
+		uint64_t random = 88172645463325252ULL;
+		size_t openedCount = 0;
+		for (int i = 0; i < 20; i++)
+		{
+			random ^= random << 13; random ^= random >> 7; random ^= random << 17;
+			openedCount += openCorrupted(sizeof(SnapshotHeader) + (size_t)(random % (file.size() - sizeof(SnapshotHeader) - 4)) / 4 * 4, (uint32_t)(random >> 32));
+		}
+		remove(corrupted_path.c_str());
+		if (!rejected)
+		{
+			cerr << "a snapshot with inconsistent offsets was opened" << endl;
+			return 1;
+		}
+		cout << "corrupted snapshots opened: " << openedCount << " of 20 (a changed count or char still fits)" << endl;
+	}
+
+	// update the mapped dictionary and save it over its own file, while another instance maps it as well
+	SymSpell reader(82765, 2, 7);
+	reader.OpenSnapshot(snapshot_path);
+	mapped.CreateDictionaryEntry(XL("snapshotword"), 1000, nullptr);
+	loaded.CreateDictionaryEntry(XL("snapshotword"), 1000, nullptr);
+	if (!mapped.SaveSnapshot(snapshot_path))
+	{
+		cerr << "a mapped snapshot could not be saved over" << endl;
+		return 1;
+	}
+	SymSpell reopened(82765, 2, 7);
+	bool reopenedOk = reopened.OpenSnapshot(snapshot_path);
+	tokens.push_back(XL("snapshotwrd"));
+	bool same = reopenedOk && Same(LookupAll(reopened, tokens), LookupAll(loaded, tokens));
+	// the other instance still reads the version it mapped
+	bool kept = Same(LookupAll(reader, vector<xstring>(tokens.begin(), tokens.end() - 1)), expected);
+	remove(snapshot_path.c_str());
+	if (!same || !kept)
+	{
+		cerr << "suggestions after saving over a mapped snapshot differ" << endl;
+		return 1;
+	}
+	cout << "suggestions of the snapshot match the dictionary" << endl;
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,112 @@
+// SortedBucketsBenchmark.cpp : time of count updates in place, which move the word within the delete buckets ordered by
+// descending count, and of Top lookups before and after them, and a check that the Top results then match a dictionary
+// loaded with the updated counts, whose buckets are sorted as a whole.
+// usage: symspell_sorted_bench [dictionary path] [number of tokens] [number of count updates]
+#include "BenchmarkData.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifndef UNICODE_SUPPORT
+
+// nanoseconds per Top lookup over all tokens, the best of a few runs, and the suggestions of the last run
+static double Run(const SymSpell& symSpell, const vector<xstring>& tokens, int maxEditDistance, vector<SuggestItem>& results)
+{
+	double best = 0;
+	for (int run = 0; run < 5; run++)
+	{
+		results.clear();
+		auto start = chrono::steady_clock::now();
+		for (const xstring& token : tokens)
+		{
+			vector<SuggestItem> suggestions = symSpell.Lookup(token, Top, maxEditDistance);
+			results.push_back(suggestions.empty() ? SuggestItem() : suggestions[0]);
+		}
+		double time = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / tokens.size();
+		if (run == 0 || time < best) best = time;
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	size_t tokenCount = argc > 2 ? (size_t)atoll(argv[2]) : 100000;
+	size_t updateCount = argc > 3 ? (size_t)atoll(argv[3]) : 20000;
+
+	SymSpell symSpell(82765, 2, 7);
+	if (!symSpell.LoadDictionary(corpus_path, 0, 1, XL(' ')))
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+	vector<xstring> words = LoadDictionaryWords(corpus_path);
+	vector<xstring> tokens = MakeTokens(words, tokenCount);
+
+	vector<double> beforeTimes;
+	vector<SuggestItem> results;
+	for (int maxEditDistance = 1; maxEditDistance <= 2; maxEditDistance++) beforeTimes.push_back(Run(symSpell, tokens, maxEditDistance, results));
+
+	// raise and lower the counts of random words, by amounts that move them far within their buckets
+	uint64_t random = 88172645463325252ULL;
+	auto next = [&random]() { random ^= random << 13; random ^= random >> 7; random ^= random << 17; return random; };
+	auto start = chrono::steady_clock::now();
+	for (size_t i = 0; i < updateCount; i++)
+	{
+		const xstring& word = words[next() % words.size()];
+		int64_t amount = (int64_t)(next() % 100000000);
+		if (i % 2 == 0) symSpell.CreateDictionaryEntry(word, amount + 1, nullptr);
+		else
+		{
+			int64_t count = symSpell.Lookup(word, Top, 0)[0].count;
+			if (count > 1) symSpell.RemoveDictionaryEntry(word, 1 + amount % (count - 1));
+		}
+	}
+	double updateTime = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / max((size_t)1, updateCount);
+	cout << "count updates: " << updateCount << ", ns per update: " << (int64_t)updateTime << endl;
+
+	// the same words and counts, loaded from a file
+	string updated_path = corpus_path + ".updated.tmp";
+	{
+		ofstream updated(updated_path);
+		for (const xstring& word : words) updated << word << " " << symSpell.Lookup(word, Top, 0)[0].count << "\n";
+	}
+	SymSpell loaded(82765, 2, 7);
+	bool opened = loaded.LoadDictionary(updated_path, 0, 1, XL(' '));
+	remove(updated_path.c_str());
+	if (!opened)
+	{
+		cerr << "updated dictionary could not be loaded: " << updated_path << endl;
+		return 1;
+	}
+
+	cout << "max edit distance\tbefore updates ns\tafter updates ns" << endl;
+	for (int maxEditDistance = 1; maxEditDistance <= 2; maxEditDistance++)
+	{
+		vector<SuggestItem> updatedResults, loadedResults;
+		double updatedTime = Run(symSpell, tokens, maxEditDistance, updatedResults);
+		Run(loaded, tokens, maxEditDistance, loadedResults);
+		for (size_t i = 0; i < tokens.size(); i++)
+		{
+			// words with equal distance and count may be found in either order
+			if (updatedResults[i].distance != loadedResults[i].distance || updatedResults[i].count != loadedResults[i].count)
+			{
+				cerr << "Top suggestions of " << tokens[i] << " differ: " << updatedResults[i].term << ", " << loadedResults[i].term << endl;
+				return 1;
+			}
+		}
+		cout << maxEditDistance << "\t" << (int64_t)beforeTimes[maxEditDistance - 1] << "\t" << (int64_t)updatedTime << endl;
+	}
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,267 @@
+// SymSpellBenchmark.cpp : throughput, latency percentiles, heap allocations per query and peak RSS of Lookup
+// for every verbosity, LookupCompound and WordSegmentation, on seeded misspellings, written as JSON to compare runs.
+// usage: symspell_bench [dictionary path] [queries per set] [seed]
+#include "BenchmarkData.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	void* p = malloc(size == 0 ? 1 : size);
+	if (p == nullptr) throw bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+#ifndef UNICODE_SUPPORT
+
+// peak resident set size of the process in KB
+static uint64_t PeakRssKb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize / 1024;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return (uint64_t)usage.ru_maxrss / 1024;
+#else
+	return (uint64_t)usage.ru_maxrss;
+#endif
+#endif
+}
+
+// xorshift generator, so that the queries only depend on the seed and the dictionary
+class Random
+{
+private:
+	uint64_t state;
+
+public:
+	Random(uint64_t seed) : state(seed == 0 ? 88172645463325252ULL : seed) {}
+	uint64_t Next() { state ^= state << 13; state ^= state >> 7; state ^= state << 17; return state; }
+	size_t Below(size_t n) { return (size_t)(Next() % n); }
+};
+
+// apply a number of random deletes, inserts, replaces and transposes of adjacent chars
+static xstring Misspell(xstring word, int edits, Random& random)
+{
+	for (int i = 0; i < edits; i++)
+	{
+		int operation = (int)random.Below(word.size() > 1 ? 4 : 2);
+		if (operation == 0 && word.size() <= 1) operation = 1;
+		size_t position = random.Below(word.size());
+		switch (operation)
+		{
+		case 0: word.erase(position, 1); break;
+		case 1: word.insert(random.Below(word.size() + 1), 1, (xchar)('a' + random.Below(26))); break;
+		case 2:
+		{
+			xchar c = word[position];
+			while (c == word[position]) c = (xchar)('a' + random.Below(26));
+			word[position] = c;
+			break;
+		}
+		case 3:
+			if (position + 1 == word.size()) position--;
+			if (word[position] == word[position + 1]) word.erase(position, 1);
+			else swap(word[position], word[position + 1]);
+			break;
+		}
+	}
+	return word;
+}
+
+// a random dictionary word, with a skewed distribution so that frequent words repeat
+static const xstring& Word(const vector<xstring>& words, Random& random)
+{
+	double u = (double)random.Below(1000000) / 1000000.0;
+	return words[(size_t)(u * u * words.size())];
+}
+
+// lines of misspelled words, some of them split or merged with the next word, for LookupCompound
+static vector<xstring> MakeSentences(const vector<xstring>& words, size_t count, Random& random)
+{
+	vector<xstring> sentences;
+	for (size_t i = 0; i < count; i++)
+	{
+		xstring sentence;
+		size_t wordCount = 3 + random.Below(6);
+		for (size_t j = 0; j < wordCount; j++)
+		{
+			xstring word = Misspell(Word(words, random), (int)random.Below(3), random);
+			if (word.size() > 3 && random.Below(10) == 0) word.insert(1 + random.Below(word.size() - 2), 1, XL(' '));
+			if (!sentence.empty() && random.Below(10) != 0) sentence += XL(' ');
+			sentence += word;
+		}
+		sentences.push_back(sentence);
+	}
+	return sentences;
+}
+
+// misspelled words without spaces, for WordSegmentation
+static vector<xstring> MakeTexts(const vector<xstring>& words, size_t count, Random& random)
+{
+	vector<xstring> texts;
+	for (size_t i = 0; i < count; i++)
+	{
+		xstring text;
+		size_t wordCount = 3 + random.Below(6);
+		for (size_t j = 0; j < wordCount; j++) text += Misspell(Word(words, random), random.Below(4) == 0 ? 1 : 0, random);
+		texts.push_back(text);
+	}
+	return texts;
+}
+
+static const char* JsonEscape(const string& s, string& escaped)
+{
+	escaped.clear();
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\') escaped += '\\';
+		if ((unsigned char)c >= 0x20) escaped += c;
+	}
+	return escaped.c_str();
+}
+
+// runs a query per input, and writes a JSON object of the set
+class Measurement
+{
+private:
+	vector<double> latencies;
+	bool first = true;
+
+	double Percentile(double p) const
+	{
+		size_t index = (size_t)(p * latencies.size());
+		return latencies[min(index, latencies.size() - 1)];
+	}
+
+public:
+	// suggestions returned by the queries (the distance sum for WordSegmentation), to check that runs compare the same work
+	uint64_t results = 0;
+
+	void Run(const string& name, const string& fields, const vector<xstring>& inputs, const function<size_t(const xstring&)>& query)
+	{
+		if (inputs.empty()) return;
+		// warm up caches and the per thread lookup context
+		for (size_t i = 0; i < min(inputs.size(), (size_t)100); i++) query(inputs[i]);
+
+		latencies.resize(inputs.size());
+		results = 0;
+		uint64_t allocationsBefore = allocations.load(memory_order_relaxed);
+		auto start = chrono::steady_clock::now();
+		for (size_t i = 0; i < inputs.size(); i++)
+		{
+			auto queryStart = chrono::steady_clock::now();
+			results += query(inputs[i]);
+			latencies[i] = chrono::duration<double, nano>(chrono::steady_clock::now() - queryStart).count();
+		}
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		uint64_t allocationCount = allocations.load(memory_order_relaxed) - allocationsBefore;
+		sort(latencies.begin(), latencies.end());
+
+		cout << (first ? "\n" : ",\n") << "    { \"name\": \"" << name << "\"" << fields
+			<< ", \"queries\": " << inputs.size() << ", \"results\": " << results
+			<< ", \"queries_per_second\": " << inputs.size() / seconds
+			<< ", \"p50_ns\": " << Percentile(0.5) << ", \"p99_ns\": " << Percentile(0.99) << ", \"p999_ns\": " << Percentile(0.999)
+			<< ", \"allocations_per_query\": " << (double)allocationCount / inputs.size()
+			<< ", \"peak_rss_kb\": " << PeakRssKb() << " }";
+		first = false;
+	}
+};
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	size_t queryCount = argc > 2 ? (size_t)atoll(argv[2]) : 1000;
+	uint64_t seed = argc > 3 ? strtoull(argv[3], nullptr, 10) : 1;
+	const int maxEditDistance = 2;
+	const int prefixLength = 7;
+
+	vector<xstring> words = LoadDictionaryWords(corpus_path);
+	auto start = chrono::steady_clock::now();
+	SymSpell symSpell(82765, maxEditDistance, prefixLength);
+	if (words.empty() || !symSpell.LoadDictionary(corpus_path, 0, 1, XL(' ')))
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+	double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	// dictionary words by length, in frequency order
+	const int lengthLimits[][2] = { { 1, 4 }, { 5, 8 }, { 9, 12 }, { 13, 1000 } };
+	const int lengthGroups = sizeof(lengthLimits) / sizeof(lengthLimits[0]);
+	vector<xstring> wordsByLength[lengthGroups];
+	for (const xstring& word : words)
+	{
+		for (int i = 0; i < lengthGroups; i++)
+		{
+			if ((int)word.size() >= lengthLimits[i][0] && (int)word.size() <= lengthLimits[i][1]) wordsByLength[i].push_back(word);
+		}
+	}
+
+	string escaped;
+	cout.precision(10);
+	cout << "{\n  \"dictionary\": \"" << JsonEscape(corpus_path, escaped) << "\", \"seed\": " << seed << ", \"queries_per_set\": " << queryCount
+		<< ", \"max_edit_distance\": " << maxEditDistance << ", \"prefix_length\": " << prefixLength
+		<< ", \"words\": " << symSpell.WordCount() << ", \"load_seconds\": " << loadSeconds << ", \"loaded_rss_kb\": " << PeakRssKb() << ",\n  \"sets\": [";
+
+	const char* verbosityNames[] = { "Top", "Closest", "All" };
+	Measurement measurement;
+	for (int edits = 0; edits <= 3; edits++)
+	{
+		for (int group = 0; group < lengthGroups; group++)
+		{
+			// seeded per set, so that a set gets the same queries whatever the other sets are
+			Random random(seed * 1000003 + edits * 101 + group);
+			vector<xstring> inputs;
+			for (size_t i = 0; i < queryCount; i++) inputs.push_back(Misspell(Word(wordsByLength[group], random), edits, random));
+			string fields = ", \"edits\": " + to_string(edits) + ", \"min_length\": " + to_string(lengthLimits[group][0])
+				+ ", \"max_length\": " + to_string(lengthLimits[group][1]);
+			for (int verbosity = Top; verbosity <= All; verbosity++)
+			{
+				measurement.Run(string("Lookup") + verbosityNames[verbosity], fields, inputs,
+					[&](const xstring& input) { return symSpell.Lookup(input, (Verbosity)verbosity, maxEditDistance).size(); });
+			}
+		}
+	}
+
+	Random random(seed);
+	measurement.Run("LookupCompound", "", MakeSentences(words, queryCount, random),
+		[&](const xstring& input) { return symSpell.LookupCompound(input, maxEditDistance).size(); });
+	measurement.Run("WordSegmentation", "", MakeTexts(words, queryCount, random),
+		[&](const xstring& input) { return (size_t)symSpell.WordSegmentation(input, maxEditDistance).getDistance(); });
+
+	cout << "\n  ],\n  \"peak_rss_kb\": " << PeakRssKb() << "\n}" << endl;
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,137 @@
+// TokenizerBenchmark.cpp : throughput of WordTokenizer compared to the regex it replaces in ParseWords, and a check that both find the same words.
+// usage: symspell_tokenizer_bench [dictionary path] [text size in MB]
+#include "BenchmarkData.h"
+
+#include <chrono>
+#include <iostream>
+
+#ifndef UNICODE_SUPPORT
+
+// words of every line, the way ParseWords found them before
+static void RegexWords(const vector<xstring>& lines, vector<xstring>& words)
+{
+	xregex r(XL("['’\\w\\-\\[_\\]]+"));
+	xsmatch m;
+	for (const xstring& line : lines)
+	{
+		xstring::const_iterator ptr(line.cbegin());
+		while (regex_search(ptr, line.cend(), m, r))
+		{
+			words.push_back(m[0]);
+			ptr = m.suffix().first;
+		}
+	}
+}
+
+static void TokenizerWords(const vector<xstring>& lines, vector<xstring_view>& words)
+{
+	for (const xstring& line : lines)
+	{
+		WordTokenizer tokenizer(line);
+		xstring_view word;
+		while (tokenizer.Next(word)) words.push_back(word);
+	}
+}
+
+static bool Same(const vector<xstring>& a, const vector<xstring_view>& b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i] != b[i]) return false;
+	}
+	return true;
+}
+
+// lines of misspelled dictionary words, separated by spaces, punctuation, and some UTF-8 encoded chars
+static vector<xstring> MakeText(const vector<xstring>& tokens, size_t size)
+{
+	const char* separators[] = { " ", " ", " ", " ", ", ", ". ", "; ", " - ", " (", ") ", "’", "'", "\"", " 1984 ", "-", " — ", " é", "\t" };
+	uint64_t random = 2463534242ULL;
+	auto next = [&random]() { random ^= random << 13; random ^= random >> 7; random ^= random << 17; return random; };
+	vector<xstring> lines;
+	xstring line;
+	size_t total = 0;
+	for (size_t i = 0; total < size; i++)
+	{
+		line += tokens[i % tokens.size()];
+		line += separators[next() % (sizeof(separators) / sizeof(separators[0]))];
+		if (line.size() >= 80 || next() % 16 == 0)
+		{
+			total += line.size() + 1;
+			lines.push_back(move(line));
+			line.clear();
+		}
+	}
+	return lines;
+}
+
+// lines of random bytes, to check the char classes
+static vector<xstring> MakeBytes(size_t count)
+{
+	uint64_t random = 88172645463325252ULL;
+	auto next = [&random]() { random ^= random << 13; random ^= random >> 7; random ^= random << 17; return random; };
+	vector<xstring> lines(count);
+	for (xstring& line : lines)
+	{
+		line.resize(next() % 64);
+		for (xchar& c : line) c = (xchar)(1 + next() % 255);
+	}
+	return lines;
+}
+
+int main(int argc, char** argv)
+{
+	string corpus_path = argc > 1 ? argv[1] : DEFAULT_BENCHMARK_DICTIONARY;
+	double megabytes = argc > 2 ? atof(argv[2]) : 16;
+
+	vector<xstring> dictionaryWords = LoadDictionaryWords(corpus_path);
+	if (dictionaryWords.empty())
+	{
+		cerr << "Dictionary not found: " << corpus_path << endl;
+		return 1;
+	}
+
+	vector<xstring> bytes = MakeBytes(100000);
+	vector<xstring> expectedBytes;
+	vector<xstring_view> actualBytes;
+	RegexWords(bytes, expectedBytes);
+	TokenizerWords(bytes, actualBytes);
+	if (!Same(expectedBytes, actualBytes))
+	{
+		cerr << "words of random bytes differ" << endl;
+		return 1;
+	}
+
+	vector<xstring> lines = MakeText(MakeTokens(dictionaryWords, 100000), (size_t)(megabytes * 1000000));
+	size_t size = 0;
+	for (const xstring& line : lines) size += line.size();
+
+	vector<xstring> expected;
+	vector<xstring_view> actual;
+	auto start = chrono::steady_clock::now();
+	RegexWords(lines, expected);
+	double regexTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	start = chrono::steady_clock::now();
+	TokenizerWords(lines, actual);
+	double tokenizerTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if (!Same(expected, actual))
+	{
+		cerr << "words differ" << endl;
+		return 1;
+	}
+
+	cout << "text: " << size / 1000000.0 << " MB, " << lines.size() << " lines, " << actual.size() << " words" << endl;
+	cout << "regex MB/s\ttokenizer MB/s\tspeedup" << endl;
+	cout << size / 1000000.0 / regexTime << "\t" << size / 1000000.0 / tokenizerTime << "\t" << regexTime / tokenizerTime << endl;
+	return 0;
+}
+
+#else
+
+int main()
+{
+	return 0;
+}
+
+#endif
@@ -14,6 +14,7 @@
 #define HashSet unordered_set
 #ifdef UNICODE_SUPPORT
 #	define xstring wstring
+#	define xstring_view wstring_view
 #	define xchar wchar_t
 #	define xifstream wifstream
 #	define xstringstream wstringstream
@@ -25,6 +26,7 @@
 #	define xcout wcout
 #else
 #	define xstring string
+#	define xstring_view string_view
 #	define xchar char
 #	define xifstream ifstream
 #	define xstringstream stringstream
@@ -38,11 +40,26 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <algorithm>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstdint>
 #include <math.h>
 #include <limits.h>
 #include <functional>
+#include <initializer_list>
+#include <charconv>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <locale>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <type_traits>
+#include <atomic>
+#include <memory>
 using namespace std;
 
 
@@ -99,6 +116,14 @@ public:
 		Count = 0;
 	}
 
+	/// <summary>Bytes of the chunks and of the chunk list.</summary>
+	size_t HeapBytes() const
+	{
+		size_t bytes = Values.capacity() * sizeof(vector<T>);
+		for (const vector<T>& chunk : Values) bytes += chunk.capacity() * sizeof(T);
+		return bytes;
+	}
+
 	T& At(unsigned int index)
 	{
 		return Values[Row(index)][Col(index)];
@@ -114,7 +139,7 @@ class Helpers {
 public:
 	/// <summary>Determines the proper return value of an edit distance function when one or
 	/// both strings are null.</summary>
-	static int NullDistanceResults(xstring string1, xstring string2, double maxDistance) {
+	static int NullDistanceResults(xstring_view string1, xstring_view string2, double maxDistance) {
 		if (string1.empty())
 			return (string2.empty()) ? 0 : (string2.size() <= maxDistance) ? string2.size() : -1;
 		return (string1.size() <= maxDistance) ? string1.size() : -1;
@@ -122,14 +147,14 @@ public:
 
 	/// <summary>Determines the proper return value of an similarity function when one or
 	/// both strings are null.</summary>
-	static int NullSimilarityResults(xstring string1, xstring string2, double minSimilarity) {
+	static int NullSimilarityResults(xstring_view string1, xstring_view string2, double minSimilarity) {
 		return (string1.empty() && string2.empty()) ? 1 : (0 <= minSimilarity) ? 0 : -1;
 	}
 
 	/// <summary>Calculates starting position and lengths of two strings such that common
 	/// prefix and suffix substrings are excluded.</summary>
 	/// <remarks>Expects string1.size() to be less than or equal to string2.size()</remarks>
-	static void PrefixSuffixPrep(xstring string1, xstring string2, int &len1, int &len2, int &start) {
+	static void PrefixSuffixPrep(xstring_view string1, xstring_view string2, int &len1, int &len2, int &start) {
 		len2 = string2.size();
 		len1 = string1.size(); // this is also the minimum length of the two strings
 		// suffix common to both strings can be ignored
@@ -161,6 +186,42 @@ public:
 		return (int)((length * (1 - similarity)) + .0000000001);
 	}
 
+	/// <summary>Find the first occurrence of a character, using the vectorized memchr/wmemchr of the C library.</summary>
+	/// <returns>Pointer to the character, or last if not found.</returns>
+	static const xchar* FindChar(const xchar* first, const xchar* last, xchar c) {
+#ifdef UNICODE_SUPPORT
+		const xchar* found = wmemchr(first, c, last - first);
+#else
+		const xchar* found = (const xchar*)memchr(first, c, last - first);
+#endif
+		return (found != nullptr) ? found : last;
+	}
+
+	/// <summary>Parse an integer like stoll, i.e. leading white space and trailing characters are ignored.</summary>
+	/// <returns>False if text does not start with an integer, or it is out of range.</returns>
+	static bool ParseInt64(xstring_view text, int64_t& value) {
+		size_t i = 0;
+		while (i < text.size() && isxspace(text[i])) i++;
+		if (i < text.size() && text[i] == XL('+')) i++;
+#ifdef UNICODE_SUPPORT
+		bool negative = (i < text.size() && text[i] == XL('-'));
+		if (negative) i++;
+		size_t start = i;
+		uint64_t result = 0;
+		for (; i < text.size() && text[i] >= XL('0') && text[i] <= XL('9'); i++) {
+			if (result > (uint64_t)LLONG_MAX / 10) return false;
+			result = result * 10 + (text[i] - XL('0'));
+			if (result > (uint64_t)LLONG_MAX + negative) return false;
+		}
+		if (i == start) return false;
+		value = negative ? (int64_t)(0 - result) : (int64_t)result;
+		return true;
+#else
+		from_chars_result result = from_chars(text.data() + i, text.data() + text.size(), value);
+		return result.ec == errc();
+#endif
+	}
+
 	/// <summary>
 	/// CompareTo of two intergers
 	/// </summary>
@@ -176,6 +237,349 @@ public:
 };
 
 
+/// <summary>Splits text into lines, and lines into separator delimited columns, without copying.</summary>
+class LineSplitter
+{
+private:
+	const xchar* position;
+	const xchar* last;
+
+public:
+	LineSplitter(xstring_view text) : position(text.data()), last(text.data() + text.size()) {}
+
+	/// <summary>Get the next line, without line terminator (\n or \r\n).</summary>
+	/// <returns>False if there are no more lines.</returns>
+	bool Next(xstring_view& line)
+	{
+		if (position == last) return false;
+		const xchar* end = Helpers::FindChar(position, last, XL('\n'));
+		line = xstring_view(position, end - position);
+		if (!line.empty() && line.back() == XL('\r')) line.remove_suffix(1);
+		position = (end == last) ? last : end + 1;
+		return true;
+	}
+
+	/// <summary>Split a line into columns, like repeated getline with a delimiter: empty columns are
+	/// kept, except after a trailing separator.</summary>
+	static void Columns(xstring_view line, xchar separator, vector<xstring_view>& columns)
+	{
+		columns.clear();
+		const xchar* first = line.data();
+		const xchar* end = line.data() + line.size();
+		while (first != end)
+		{
+			const xchar* next = Helpers::FindChar(first, end, separator);
+			columns.push_back(xstring_view(first, next - first));
+			first = (next == end) ? end : next + 1;
+		}
+	}
+};
+
+
+/// <summary>Decoding of UTF-8 encoded text into code points.</summary>
+/// <remarks>A byte that does not start a well-formed sequence (RFC 3629) is a code point by itself, as
+/// 0xDC00 + byte, which is a lone surrogate that no well-formed sequence decodes to. So any text decodes
+/// to distinct code points, and malformed text is still handled byte by byte.</remarks>
+class Utf8
+{
+public:
+	/// <summary>True if all bytes are below 128, so that every byte is a code point.</summary>
+	static bool IsAscii(string_view text)
+	{
+		const char* p = text.data();
+		const char* end = p + text.size();
+		uint64_t bits = 0;
+		for (; end - p >= 8; p += 8)
+		{
+			uint64_t word;
+			memcpy(&word, p, sizeof(word));
+			bits |= word;
+		}
+		for (; p != end; p++) bits |= (unsigned char)*p;
+		return (bits & 0x8080808080808080ULL) == 0;
+	}
+
+	/// <summary>Decode the code point at p.</summary>
+	/// <param name="codePoint">Receives the code point.</param>
+	/// <returns>The length of its sequence, or 0 if end cuts a well-formed sequence short.</returns>
+	static int Next(const char* p, const char* end, char32_t& codePoint)
+	{
+		unsigned char lead = (unsigned char)*p;
+		if (lead < 0x80)
+		{
+			codePoint = lead;
+			return 1;
+		}
+		int length;
+		char32_t value;
+		// range of the second byte, which excludes overlong forms, surrogates and values above 0x10FFFF
+		unsigned char low = 0x80, high = 0xBF;
+		if (lead >= 0xC2 && lead <= 0xDF) { length = 2; value = lead & 0x1F; }
+		else if (lead >= 0xE0 && lead <= 0xEF)
+		{
+			length = 3;
+			value = lead & 0x0F;
+			if (lead == 0xE0) low = 0xA0;
+			else if (lead == 0xED) high = 0x9F;
+		}
+		else if (lead >= 0xF0 && lead <= 0xF4)
+		{
+			length = 4;
+			value = lead & 0x07;
+			if (lead == 0xF0) low = 0x90;
+			else if (lead == 0xF4) high = 0x8F;
+		}
+		else
+		{
+			codePoint = 0xDC00 + lead;
+			return 1;
+		}
+		for (int i = 1; i < length; i++)
+		{
+			if (p + i == end) return 0;
+			unsigned char c = (unsigned char)p[i];
+			if (c < low || c > high)
+			{
+				codePoint = 0xDC00 + lead;
+				return 1;
+			}
+			low = 0x80;
+			high = 0xBF;
+			value = (value << 6) | (c & 0x3F);
+		}
+		codePoint = value;
+		return length;
+	}
+
+	/// <summary>Decode the code point at p, where end is the end of the text.</summary>
+	/// <returns>The length of its sequence.</returns>
+	static int Decode(const char* p, const char* end, char32_t& codePoint)
+	{
+		int length = Next(p, end, codePoint);
+		if (length != 0) return length;
+		codePoint = 0xDC00 + (unsigned char)*p;
+		return 1;
+	}
+
+	/// <summary>Decode a text. Reuses the buffer of earlier texts.</summary>
+	static void Decode(string_view text, u32string& codePoints)
+	{
+		codePoints.clear();
+		const char* end = text.data() + text.size();
+		char32_t codePoint;
+		for (const char* p = text.data(); p != end; )
+		{
+			p += Decode(p, end, codePoint);
+			codePoints.push_back(codePoint);
+		}
+	}
+
+	/// <summary>Number of code points of a text.</summary>
+	static int Length(string_view text)
+	{
+		if (IsAscii(text)) return (int)text.size();
+		const char* end = text.data() + text.size();
+		char32_t codePoint;
+		int length = 0;
+		for (const char* p = text.data(); p != end; p += Decode(p, end, codePoint)) length++;
+		return length;
+	}
+
+	/// <summary>Byte offsets of the code points of a text, followed by the length of the text.</summary>
+	static void Offsets(string_view text, vector<int>& offsets)
+	{
+		offsets.clear();
+		const char* end = text.data() + text.size();
+		char32_t codePoint;
+		for (const char* p = text.data(); p != end; p += Decode(p, end, codePoint)) offsets.push_back((int)(p - text.data()));
+		offsets.push_back((int)text.size());
+	}
+};
+
+
+/// <summary>Splits text into words, the runs of letters, digits and the chars _ ' ’ - [ ], without copying.</summary>
+/// <remarks>Finds the same words as the regex ['’\w\-\[_\]]+: chars below 128 are classified by a table, others
+/// by the letters and digits of the global locale, like \w. Without UNICODE_SUPPORT the text is not decoded, so
+/// each byte of the UTF-8 encoded ’ is a word char by itself, unless the tokenizer is created for UTF-8 text: then
+/// text that is not ASCII is decoded, and its code points are classified like the chars of UNICODE_SUPPORT builds.
+/// Other text is classified in blocks of 64 chars into a bit mask, without branches for ASCII text, and the words
+/// are found as the runs of set bits.</remarks>
+class WordTokenizer
+{
+private:
+	const xchar* text;
+	size_t size;
+	// start of the current block, its word char bits, and the position to continue from within the block
+	size_t block = 0;
+	uint64_t bits = 0;
+	size_t position = 0;
+	// letters and digits of the global locale, taken when the first char of 128 or above is classified
+	mutable const ctype<xchar>* letters = nullptr;
+#ifndef UNICODE_SUPPORT
+	// the text is UTF-8 and not ASCII, so it is decoded
+	bool codePoints = false;
+	mutable const ctype<wchar_t>* wideLetters = nullptr;
+#endif
+
+	// word chars below 128
+	struct AsciiTable
+	{
+		bool word[128];
+
+		AsciiTable()
+		{
+			for (int c = 0; c < 128; c++)
+			{
+				word[c] = (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')
+					|| c == '_' || c == '\'' || c == '-' || c == '[' || c == ']';
+			}
+		}
+	};
+
+	static const AsciiTable& Ascii()
+	{
+		static const AsciiTable table;
+		return table;
+	}
+
+	static int TrailingZeros(uint64_t x)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, x);
+		return (int)index;
+#else
+		return __builtin_ctzll(x);
+#endif
+	}
+
+	bool IsWordCharSlow(xchar c) const
+	{
+#ifdef UNICODE_SUPPORT
+		if (c == L'\u2019') return true;
+#else
+		// the bytes of ’ (E2 80 99)
+		if ((unsigned char)c == 0xE2 || (unsigned char)c == 0x80 || (unsigned char)c == 0x99) return true;
+#endif
+		if (letters == nullptr) letters = &use_facet<ctype<xchar>>(locale());
+		return letters->is(ctype_base::alnum, c);
+	}
+
+	// word char bits of the block starting at first, the bits past the end of the text are 0
+	uint64_t Classify(size_t first) const
+	{
+		typedef make_unsigned<xchar>::type uchar;
+		const bool* ascii = Ascii().word;
+		size_t count = min((size_t)64, size - first);
+		const xchar* chars = text + first;
+		uint64_t result = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			uchar c = (uchar)chars[i];
+			result |= (uint64_t)(c < 128 ? ascii[c] : IsWordCharSlow(chars[i])) << i;
+		}
+		return result;
+	}
+
+#ifndef UNICODE_SUPPORT
+	bool IsWordCodePoint(char32_t c) const
+	{
+		if (c < 128) return Ascii().word[c];
+		if (c == 0x2019) return true;
+		// malformed bytes, and code points that don't fit into wchar_t, are not letters
+		if ((c >= 0xD800 && c <= 0xDFFF) || c > (char32_t)WCHAR_MAX) return false;
+		if (wideLetters == nullptr) wideLetters = &use_facet<ctype<wchar_t>>(locale());
+		return wideLetters->is(ctype_base::alnum, (wchar_t)c);
+	}
+
+	// Next for decoded text, a code point at a time
+	bool NextCodePoints(xstring_view& word)
+	{
+		const char* end = text + size;
+		char32_t c;
+		int length;
+		for (;; position += length)
+		{
+			if (position >= size) return false;
+			length = Utf8::Decode(text + position, end, c);
+			if (IsWordCodePoint(c)) break;
+		}
+		size_t first = position;
+		for (position += length; position < size; position += length)
+		{
+			length = Utf8::Decode(text + position, end, c);
+			if (!IsWordCodePoint(c)) break;
+		}
+		word = xstring_view(text + first, position - first);
+		return true;
+	}
+#endif
+
+public:
+	/// <summary>Create a tokenizer of a text.</summary>
+	/// <param name="utf8">True if the text is UTF-8 encoded, which is ignored with UNICODE_SUPPORT.</param>
+	WordTokenizer(xstring_view text, bool utf8 = false) : text(text.data()), size(text.size())
+	{
+#ifndef UNICODE_SUPPORT
+		codePoints = utf8 && !Utf8::IsAscii(text);
+		if (codePoints) return;
+#endif
+		if (size > 0) bits = Classify(0);
+	}
+
+	/// <summary>True if the char is part of words.</summary>
+	bool IsWordChar(xchar c) const
+	{
+		typedef make_unsigned<xchar>::type uchar;
+		return (uchar)c < 128 ? Ascii().word[(uchar)c] : IsWordCharSlow(c);
+	}
+
+	/// <summary>Get the next word.</summary>
+	/// <returns>False if there are no more words.</returns>
+	bool Next(xstring_view& word)
+	{
+#ifndef UNICODE_SUPPORT
+		if (codePoints) return NextCodePoints(word);
+#endif
+		if (position >= size) return false;
+		// first word char
+		uint64_t found = bits & (~0ULL << (position - block));
+		while (found == 0)
+		{
+			block += 64;
+			if (block >= size)
+			{
+				position = size;
+				return false;
+			}
+			bits = found = Classify(block);
+		}
+		size_t first = block + TrailingZeros(found);
+		// first char that is not a word char
+		found = ~bits & (~0ULL << (first - block));
+		while (found == 0)
+		{
+			block += 64;
+			if (block >= size) break;
+			bits = Classify(block);
+			found = ~bits;
+		}
+		position = (block >= size) ? size : block + TrailingZeros(found);
+		word = xstring_view(text + first, position - first);
+		return true;
+	}
+
+	/// <summary>All words of a text.</summary>
+	static void Words(xstring_view text, vector<xstring_view>& words, bool utf8 = false)
+	{
+		words.clear();
+		WordTokenizer tokenizer(text, utf8);
+		xstring_view word;
+		while (tokenizer.Next(word)) words.push_back(word);
+	}
+};
+
+
 /// <summary>Types implementing the IDistance interface provide methods
 /// for computing a relative distance between two strings.</summary>
 class IDistance {
@@ -185,7 +589,7 @@ public:
 	/// <param name="string2">The other string to compare.</param>
 	/// <returns>0 if the strings are equivalent, otherwise a positive number whose
 	/// magnitude increases as difference between the strings increases.</returns>
-	virtual double Distance(xstring string1, xstring string2) = 0;
+	virtual double Distance(xstring_view string1, xstring_view string2) = 0;
 
 	/// <summary>Return a measure of the distance between two strings.</summary>
 	/// <param name="string1">One of the strings to compare.</param>
@@ -194,7 +598,7 @@ public:
 	/// <returns>-1 if the distance is greater than the maxDistance, 0 if the strings
 	/// are equivalent, otherwise a positive number whose magnitude increases as
 	/// difference between the strings increases.</returns>
-	virtual double Distance(xstring string1, xstring string2, double maxDistance) = 0;
+	virtual double Distance(xstring_view string1, xstring_view string2, double maxDistance) = 0;
 };
 
 
@@ -207,7 +611,7 @@ public:
 	/// <param name="string2">The other string to compare.</param>
 	/// <returns>The degree of similarity 0 to 1.0, where 0 represents a lack of any
 	/// notable similarity, and 1 represents equivalent strings.</returns>
-	virtual double Similarity(xstring string1, xstring string2) = 0;
+	virtual double Similarity(xstring_view string1, xstring_view string2) = 0;
 
 	/// <summary>Return a measure of the similarity between two strings.</summary>
 	/// <param name="string1">One of the strings to compare.</param>
@@ -217,7 +621,235 @@ public:
 	/// lower than minSimilarity, otherwise, a number between 0 and 1.0 where 0
 	/// represents a lack of any notable similarity, and 1 represents equivalent
 	/// strings.</returns>
-	virtual double Similarity(xstring string1, xstring string2, double minSimilarity) = 0;
+	virtual double Similarity(xstring_view string1, xstring_view string2, double minSimilarity) = 0;
+};
+
+/// <summary>Bit-parallel computation of the Levenshtein and Damerau-Levenshtein optimal string
+/// alignment distance of a pattern string to other strings.</summary>
+/// <remarks>Myers' algorithm, with Hyyrö's extension for adjacent transpositions
+/// (H. Hyyrö, "A bit-vector algorithm for computing Levenshtein and Damerau edit distances", 2003).
+/// A column of the edit distance matrix is encoded as bit vectors of vertical +1/-1 differences,
+/// so a character of the other string is processed in a few word operations for patterns of up
+/// to 64 characters, and in one pass over 64-bit blocks for longer patterns.
+/// Characters are compared by code, so the pattern and the other strings may be of chars or of
+/// code points, e.g. of decoded UTF-8 text.
+/// The methods in this class are not threadsafe.</remarks>
+class BitParallelDistance
+{
+private:
+	struct Block
+	{
+		uint64_t vp;     // vertical positive differences
+		uint64_t vn;     // vertical negative differences
+		uint64_t d0;     // diagonal zero differences of the previous column
+		uint64_t match;  // match mask of the previous character
+	};
+
+	u32string pattern;
+	int blockCount = 0;
+	// match masks of characters below 256 of a pattern of a single block, which is the common case
+	bool smallPattern = false;
+	uint64_t smallMasks[256] = { 0 };
+	// 1 + index of the masks of characters below 256, or 0 if not in the pattern
+	vector<uint32_t> smallChars = vector<uint32_t>(256, 0);
+	// open addressing table of the characters >= 256 of the pattern, with 1 + index of their masks
+	vector<uint32_t> largeChars;
+	vector<uint32_t> largeIndexes;
+	bool hasLargeChars = false;
+	// match masks of every distinct pattern character, blockCount words each
+	vector<uint64_t> masks;
+	vector<Block> blocks;
+
+	template <class Char>
+	static uint32_t Code(Char c) { return (uint32_t)(typename make_unsigned<Char>::type)c; }
+
+	uint32_t Index(uint32_t code) const
+	{
+		if (code < 256) return smallChars[code];
+		if (!hasLargeChars) return 0;
+		uint32_t mask = (uint32_t)largeChars.size() - 1;
+		for (uint32_t i = (code * 2654435769u) & mask; largeIndexes[i] != 0; i = (i + 1) & mask)
+		{
+			if (largeChars[i] == code) return largeIndexes[i];
+		}
+		return 0;
+	}
+
+	uint32_t AddIndex(uint32_t code)
+	{
+		uint32_t* index;
+		if (code < 256) index = &smallChars[code];
+		else
+		{
+			if (largeChars.size() < pattern.size() * 2)
+			{
+				size_t capacity = 16;
+				while (capacity < pattern.size() * 2) capacity *= 2;
+				largeChars.assign(capacity, 0);
+				largeIndexes.assign(capacity, 0);
+			}
+			hasLargeChars = true;
+			uint32_t mask = (uint32_t)largeChars.size() - 1;
+			uint32_t i = (code * 2654435769u) & mask;
+			while (largeIndexes[i] != 0 && largeChars[i] != code) i = (i + 1) & mask;
+			largeChars[i] = code;
+			index = &largeIndexes[i];
+		}
+		if (*index == 0)
+		{
+			masks.resize(masks.size() + blockCount, 0);
+			*index = (uint32_t)(masks.size() / blockCount);
+		}
+		return *index;
+	}
+
+	template <bool Transpositions, class Text>
+	int SingleBlockDistance(const Text& text, int maxDistance) const
+	{
+		uint64_t vp = ~(uint64_t)0, vn = 0, d0 = 0, previousMatch = 0;
+		uint64_t last = (uint64_t)1 << (pattern.size() - 1);
+		int distance = (int)pattern.size();
+		int remaining = (int)text.size();
+		for (auto c : text)
+		{
+			uint64_t match;
+			if (smallPattern) match = (Code(c) < 256) ? smallMasks[Code(c)] : 0;
+			else
+			{
+				uint32_t index = Index(Code(c));
+				match = (index != 0) ? masks[index - 1] : 0;
+			}
+			uint64_t transposition = Transpositions ? (((~d0) & match) << 1) & previousMatch : 0;
+			d0 = (((match & vp) + vp) ^ vp) | match | vn | transposition;
+			uint64_t hp = vn | ~(d0 | vp);
+			uint64_t hn = d0 & vp;
+			if (hp & last) distance++;
+			else if (hn & last) distance--;
+			hp = (hp << 1) | 1;
+			hn = hn << 1;
+			vp = hn | ~(d0 | hp);
+			vn = hp & d0;
+			previousMatch = match;
+			// every remaining character can lower the distance by at most 1
+			if (distance - --remaining > maxDistance) return -1;
+		}
+		return (distance <= maxDistance) ? distance : -1;
+	}
+
+	template <bool Transpositions, class Text>
+	int MultiBlockDistance(const Text& text, int maxDistance)
+	{
+		blocks.assign(blockCount, Block{ ~(uint64_t)0, 0, 0, 0 });
+		uint64_t last = (uint64_t)1 << ((pattern.size() - 1) & 63);
+		int distance = (int)pattern.size();
+		int remaining = (int)text.size();
+		for (auto c : text)
+		{
+			uint32_t index = Index(Code(c));
+			const uint64_t* match = (index != 0) ? &masks[(size_t)(index - 1) * blockCount] : nullptr;
+			uint64_t hpCarry = 1, hnCarry = 0, addCarry = 0;
+			// match and previous d0 of the block below, for transpositions across the block boundary
+			uint64_t lowerMatch = 0, lowerD0 = ~(uint64_t)0;
+			for (int b = 0; b < blockCount; b++)
+			{
+				Block& block = blocks[b];
+				uint64_t blockMatch = (match != nullptr) ? match[b] : 0;
+				uint64_t transposition = 0;
+				if (Transpositions)
+				{
+					transposition = ((((~block.d0) & blockMatch) << 1) | (((~lowerD0) & lowerMatch) >> 63)) & block.match;
+					lowerMatch = blockMatch;
+					lowerD0 = block.d0;
+				}
+				uint64_t x = blockMatch & block.vp;
+				uint64_t sum = x + block.vp;
+				uint64_t carry = (sum < x) ? 1 : 0;
+				sum += addCarry;
+				if (sum < addCarry) carry = 1;
+				addCarry = carry;
+				uint64_t d0 = (sum ^ block.vp) | blockMatch | block.vn | transposition;
+				uint64_t hp = block.vn | ~(d0 | block.vp);
+				uint64_t hn = d0 & block.vp;
+				if (b == blockCount - 1)
+				{
+					if (hp & last) distance++;
+					else if (hn & last) distance--;
+				}
+				uint64_t hpShifted = (hp << 1) | hpCarry;
+				uint64_t hnShifted = (hn << 1) | hnCarry;
+				hpCarry = hp >> 63;
+				hnCarry = hn >> 63;
+				block.vp = hnShifted | ~(d0 | hpShifted);
+				block.vn = hpShifted & d0;
+				block.d0 = d0;
+				block.match = blockMatch;
+			}
+			if (distance - --remaining > maxDistance) return -1;
+		}
+		return (distance <= maxDistance) ? distance : -1;
+	}
+
+public:
+	/// <summary>Set the pattern that following Distance calls compare to.</summary>
+	/// <param name="pattern">The pattern string, which must not be empty.</param>
+	template <class Text>
+	void SetPattern(const Text& pattern)
+	{
+		if (smallPattern)
+		{
+			for (uint32_t code : this->pattern) smallMasks[code] = 0;
+		}
+		else
+		{
+			for (uint32_t code : this->pattern)
+			{
+				if (code < 256) smallChars[code] = 0;
+			}
+			if (hasLargeChars)
+			{
+				fill(largeIndexes.begin(), largeIndexes.end(), 0);
+				hasLargeChars = false;
+			}
+		}
+		this->pattern.resize(pattern.size());
+		for (size_t i = 0; i < pattern.size(); i++) this->pattern[i] = Code(pattern[i]);
+		blockCount = max(1, (int)((pattern.size() + 63) / 64));
+
+		smallPattern = (blockCount == 1);
+		for (uint32_t code : this->pattern) smallPattern &= (code < 256);
+		if (smallPattern)
+		{
+			for (size_t i = 0; i < pattern.size(); i++) smallMasks[this->pattern[i]] |= (uint64_t)1 << i;
+			return;
+		}
+		masks.clear();
+		for (size_t i = 0; i < pattern.size(); i++)
+		{
+			uint32_t index = AddIndex(this->pattern[i]);
+			masks[(size_t)(index - 1) * blockCount + i / 64] |= (uint64_t)1 << (i & 63);
+		}
+	}
+
+	/// <summary>The codes of the pattern chars that Distance calls compare to.</summary>
+	u32string_view Pattern() const { return pattern; }
+
+	/// <summary>Compute the edit distance between the pattern and a string.</summary>
+	/// <param name="text">The string to compare.</param>
+	/// <param name="transpositions">True for the Damerau-Levenshtein optimal string alignment distance,
+	/// false for the Levenshtein distance.</param>
+	/// <param name="maxDistance">The maximum distance that is of interest.</param>
+	/// <returns>The edit distance, or -1 if it is greater than maxDistance.</returns>
+	template <class Text>
+	int Distance(const Text& text, bool transpositions, int maxDistance)
+	{
+		if (pattern.empty()) return ((int)text.size() <= maxDistance) ? (int)text.size() : -1;
+		if (text.empty()) return ((int)pattern.size() <= maxDistance) ? (int)pattern.size() : -1;
+		if (blockCount == 1)
+		{
+			return transpositions ? SingleBlockDistance<true>(text, maxDistance) : SingleBlockDistance<false>(text, maxDistance);
+		}
+		return transpositions ? MultiBlockDistance<true>(text, maxDistance) : MultiBlockDistance<false>(text, maxDistance);
+	}
 };
 
 /// <summary>
@@ -252,8 +884,13 @@ public:
 /// class if that is required.</remarks>
 class DamerauOSA : public IDistance {
 private:
-	vector<int> baseChar1Costs;
-	vector<int> basePrevChar1Costs;
+	BitParallelDistance kernel;
+
+	// distance of the parts of two strings that remain after removing their common prefix and suffix
+	int MiddleDistance(xstring_view string1, xstring_view string2, int len1, int len2, int start, int maxDistance) {
+		kernel.SetPattern(string1.substr(start, len1));
+		return kernel.Distance(string2.substr(start, len2), true, maxDistance);
+	}
 
 public:
 	/// <summary>Create a new instance of DamerauOSA.</summary>
@@ -268,8 +905,6 @@ public:
 	/// be passed to the edit distance functions.</param>
 	DamerauOSA(int expectedMaxstringLength) {
 		if (expectedMaxstringLength <= 0) throw "expectedMaxstringLength must be larger than 0";
-		this->baseChar1Costs = vector<int>(expectedMaxstringLength, 0);
-		this->basePrevChar1Costs = vector<int>(expectedMaxstringLength, 0);
 	}
 
 	/// <summary>Compute and return the Damerau-Levenshtein optimal string
@@ -280,24 +915,20 @@ public:
 	/// <param name="string2">The other string to compare.</param>
 	/// <returns>0 if the strings are equivalent, otherwise a positive number whose
 	/// magnitude increases as difference between the strings increases.</returns>
-	double Distance(xstring string1, xstring string2) {
+	double Distance(xstring_view string1, xstring_view string2) {
 		if (string1.empty()) return string2.size();
 		if (string2.empty()) return string1.size();
 
 		// if strings of different lengths, ensure shorter string is in string1. This can result in a little
 		// faster speed by spending more time spinning just the inner loop during the main processing.
-		if (string1.size() > string2.size()) { xstring t = string1; string1 = string2; string2 = t; }
+		if (string1.size() > string2.size()) swap(string1, string2);
 
 		// identify common suffix and/or prefix that can be ignored
 		int len1, len2, start;
 		Helpers::PrefixSuffixPrep(string1, string2, len1, len2, start);
 		if (len1 == 0) return len2;
 
-		if (len2 > this->baseChar1Costs.size()) {
-			this->baseChar1Costs = vector<int>(len2, 0);
-			this->basePrevChar1Costs = vector<int>(len2, 0);
-		}
-		return Distance(string1, string2, len1, len2, start, this->baseChar1Costs, this->basePrevChar1Costs);
+		return MiddleDistance(string1, string2, len1, len2, start, INT_MAX);
 	}
 
 	/// <summary>Compute and return the Damerau-Levenshtein optimal string
@@ -310,7 +941,7 @@ public:
 	/// <returns>-1 if the distance is greater than the maxDistance, 0 if the strings
 	/// are equivalent, otherwise a positive number whose magnitude increases as
 	/// difference between the strings increases.</returns>
-	double Distance(xstring string1, xstring string2, double maxDistance) {
+	double Distance(xstring_view string1, xstring_view string2, double maxDistance) {
 		if (string1.empty() || string2.empty()) return Helpers::NullDistanceResults(string1, string2, maxDistance);
 		if (maxDistance <= 0) return (string1 == string2) ? 0 : -1;
 		maxDistance = ceil(maxDistance);
@@ -318,7 +949,7 @@ public:
 
 		// if strings of different lengths, ensure shorter string is in string1. This can result in a little
 		// faster speed by spending more time spinning just the inner loop during the main processing.
-		if (string1.size() > string2.size()) { xstring t = string1; string1 = string2; string2 = t; }
+		if (string1.size() > string2.size()) swap(string1, string2);
 		if (string2.size() - string1.size() > iMaxDistance) return -1;
 
 		// identify common suffix and/or prefix that can be ignored
@@ -326,14 +957,7 @@ public:
 		Helpers::PrefixSuffixPrep(string1, string2, len1, len2, start);
 		if (len1 == 0) return (len2 <= iMaxDistance) ? len2 : -1;
 
-		if (len2 > this->baseChar1Costs.size()) {
-			this->baseChar1Costs = vector<int>(len2, 0);
-			this->basePrevChar1Costs = vector<int>(len2, 0);
-		}
-		if (iMaxDistance < len2) {
-			return Distance(string1, string2, len1, len2, start, iMaxDistance, this->baseChar1Costs, this->basePrevChar1Costs);
-		}
-		return Distance(string1, string2, len1, len2, start, this->baseChar1Costs, this->basePrevChar1Costs);
+		return MiddleDistance(string1, string2, len1, len2, start, iMaxDistance);
 	}
 
 	/// <summary>Return Damerau-Levenshtein optimal string alignment similarity
@@ -342,25 +966,20 @@ public:
 	/// <param name="string2">The other string to compare.</param>
 	/// <returns>The degree of similarity 0 to 1.0, where 0 represents a lack of any
 	/// noteable similarity, and 1 represents equivalent strings.</returns>
-	double Similarity(xstring string1, xstring string2) {
+	double Similarity(xstring_view string1, xstring_view string2) {
 		if (string1.empty()) return (string2.empty()) ? 1 : 0;
 		if (string2.empty()) return 0;
 
 		// if strings of different lengths, ensure shorter string is in string1. This can result in a little
 		// faster speed by spending more time spinning just the inner loop during the main processing.
-		if (string1.size() > string2.size()) { xstring t = string1; string1 = string2; string2 = t; }
+		if (string1.size() > string2.size()) swap(string1, string2);
 
 		// identify common suffix and/or prefix that can be ignored
 		int len1, len2, start;
 		Helpers::PrefixSuffixPrep(string1, string2, len1, len2, start);
 		if (len1 == 0) return 1.0;
 
-		if (len2 > this->baseChar1Costs.size()) {
-			this->baseChar1Costs = vector<int>(len2, 0);
-			this->basePrevChar1Costs = vector<int>(len2, 0);
-		}
-		return Helpers::ToSimilarity(Distance(string1, string2, len1, len2, start, this->baseChar1Costs, this->basePrevChar1Costs)
-			, string2.size());
+		return Helpers::ToSimilarity(MiddleDistance(string1, string2, len1, len2, start, INT_MAX), string2.size());
 	}
 
 	/// <summary>Return Damerau-Levenshtein optimal string alignment similarity
@@ -372,13 +991,13 @@ public:
 	/// lower than minSimilarity, otherwise, a number between 0 and 1.0 where 0
 	/// represents a lack of any noteable similarity, and 1 represents equivalent
 	/// strings.</returns>
-	double Similarity(xstring string1, xstring string2, double minSimilarity) {
+	double Similarity(xstring_view string1, xstring_view string2, double minSimilarity) {
 		if (minSimilarity < 0 || minSimilarity > 1) throw "minSimilarity must be in range 0 to 1.0";
 		if (string1.empty() || string2.empty()) return Helpers::NullSimilarityResults(string1, string2, minSimilarity);
 
 		// if strings of different lengths, ensure shorter string is in string1. This can result in a little
 		// faster speed by spending more time spinning just the inner loop during the main processing.
-		if (string1.size() > string2.size()) { xstring t = string1; string1 = string2; string2 = t; }
+		if (string1.size() > string2.size()) swap(string1, string2);
 
 		int iMaxDistance = Helpers::ToDistance(minSimilarity, string2.size());
 		if (string2.size() - string1.size() > iMaxDistance) return -1;
@@ -389,21 +1008,12 @@ public:
 		Helpers::PrefixSuffixPrep(string1, string2, len1, len2, start);
 		if (len1 == 0) return 1.0;
 
-		if (len2 > this->baseChar1Costs.size()) {
-			this->baseChar1Costs = vector<int>(len2, 0);
-			this->basePrevChar1Costs = vector<int>(len2, 0);
-		}
-		if (iMaxDistance < len2) {
-			return Helpers::ToSimilarity(Distance(string1, string2, len1, len2, start, iMaxDistance, this->baseChar1Costs, this->basePrevChar1Costs)
-				, string2.size());
-		}
-		return Helpers::ToSimilarity(Distance(string1, string2, len1, len2, start, this->baseChar1Costs, this->basePrevChar1Costs)
-			, string2.size());
+		return Helpers::ToSimilarity(MiddleDistance(string1, string2, len1, len2, start, iMaxDistance), string2.size());
 	}
 
 	/// <summary>Internal implementation of the core Damerau-Levenshtein, optimal string alignment algorithm.</summary>
 	/// <remarks>https://github.com/softwx/SoftWx.Match</remarks>
-	static int Distance(xstring string1, xstring string2, int len1, int len2, int start, vector<int> char1Costs, vector<int> prevChar1Costs) {
+	static int Distance(xstring_view string1, xstring_view string2, int len1, int len2, int start, vector<int>& char1Costs, vector<int>& prevChar1Costs) {
 		int j;
 		for (j = 0; j < len2; j++) char1Costs[j] = j + 1;
 		xchar char1 = XL(' ');
@@ -442,7 +1052,7 @@ public:
 
 	/// <summary>Internal implementation of the core Damerau-Levenshtein, optimal string alignment algorithm
 	/// that accepts a maxDistance.</summary>
-	static int Distance(xstring string1, xstring string2, int len1, int len2, int start, int maxDistance, vector<int> char1Costs, vector<int> prevChar1Costs) {
+	static int Distance(xstring_view string1, xstring_view string2, int len1, int len2, int start, int maxDistance, vector<int>& char1Costs, vector<int>& prevChar1Costs) {
 		int i, j;
 		//for (j = 0; j < maxDistance; j++) char1Costs[j] = j+1;
 		for (j = 0; j < maxDistance; j++)
@@ -512,13 +1122,17 @@ public:
 	/// class if that is required.</remarks>
 class Levenshtein : public IDistance, ISimilarity {
 private:
-	vector<int> baseChar1Costs;
+	BitParallelDistance kernel;
 
-public:
+	// distance of the parts of two strings that remain after removing their common prefix and suffix
+	int MiddleDistance(xstring_view string1, xstring_view string2, int len1, int len2, int start, int maxDistance) {
+		kernel.SetPattern(string1.substr(start, len1));
+		return kernel.Distance(string2.substr(start, len2), false, maxDistance);
+	}
 
-	/// <summary>Create a new instance of DamerauOSA.</summary>
+public:
+	/// <summary>Create a new instance of Levenshtein.</summary>
 	Levenshtein() {
-
 	}
 
 	/// <summary>Create a new instance of Levenshtein using the specified expected
@@ -529,7 +1143,6 @@ public:
 	/// be passed to the Levenshtein methods.</param>
 	Levenshtein(int expectedMaxstringLength) {
 		if (expectedMaxstringLength <= 0) throw "expectedMaxstringLength must be larger than 0";
-		this->baseChar1Costs = vector<int>(expectedMaxstringLength, 0);
 	}
 
 	/// <summary>Compute and return the Levenshtein edit distance between two strings.</summary>
@@ -539,21 +1152,20 @@ public:
 	/// <param name="string2">The other string to compare.</param>
 	/// <returns>0 if the strings are equivalent, otherwise a positive number whose
 	/// magnitude increases as difference between the strings increases.</returns>
-	double Distance(xstring string1, xstring string2) {
+	double Distance(xstring_view string1, xstring_view string2) {
 		if (string1.empty()) return string2.size();
 		if (string2.empty()) return string1.size();
 
 		// if strings of different lengths, ensure shorter string is in string1. This can result in a little
 		// faster speed by spending more time spinning just the inner loop during the main processing.
-		if (string1.size() > string2.size()) { xstring t = string1; string1 = string2; string2 = t; }
+		if (string1.size() > string2.size()) swap(string1, string2);
 
 		// identify common suffix and/or prefix that can be ignored
 		int len1, len2, start;
 		Helpers::PrefixSuffixPrep(string1, string2, len1, len2, start);
 		if (len1 == 0) return len2;
 
-		return Distance(string1, string2, len1, len2, start,
-			(this->baseChar1Costs = (len2 <= this->baseChar1Costs.size()) ? this->baseChar1Costs : vector<int>(len2, 0)));
+		return MiddleDistance(string1, string2, len1, len2, start, INT_MAX);
 	}
 
 	/// <summary>Compute and return the Levenshtein edit distance between two strings.</summary>
@@ -565,7 +1177,7 @@ public:
 	/// <returns>-1 if the distance is greater than the maxDistance, 0 if the strings
 	/// are equivalent, otherwise a positive number whose magnitude increases as
 	/// difference between the strings increases.</returns>
-	double Distance(xstring string1, xstring string2, double maxDistance) {
+	double Distance(xstring_view string1, xstring_view string2, double maxDistance) {
 		if (string1.empty() || string2.empty()) return Helpers::NullDistanceResults(string1, string2, maxDistance);
 		if (maxDistance <= 0) return (string1 == string2) ? 0 : -1;
 		maxDistance = ceil(maxDistance);
@@ -573,7 +1185,7 @@ public:
 
 		// if strings of different lengths, ensure shorter string is in string1. This can result in a little
 		// faster speed by spending more time spinning just the inner loop during the main processing.
-		if (string1.size() > string2.size()) { xstring t = string1; string1 = string2; string2 = t; }
+		if (string1.size() > string2.size()) swap(string1, string2);
 		if (string2.size() - string1.size() > iMaxDistance) return -1;
 
 		// identify common suffix and/or prefix that can be ignored
@@ -581,12 +1193,7 @@ public:
 		Helpers::PrefixSuffixPrep(string1, string2, len1, len2, start);
 		if (len1 == 0) return (len2 <= iMaxDistance) ? len2 : -1;
 
-		if (iMaxDistance < len2) {
-			return Distance(string1, string2, len1, len2, start, iMaxDistance,
-				(this->baseChar1Costs = (len2 <= this->baseChar1Costs.size()) ? this->baseChar1Costs : vector<int>(len2, 0)));
-		}
-		return Distance(string1, string2, len1, len2, start,
-			(this->baseChar1Costs = (len2 <= this->baseChar1Costs.size()) ? this->baseChar1Costs : vector<int>(len2, 0)));
+		return MiddleDistance(string1, string2, len1, len2, start, iMaxDistance);
 	}
 
 	/// <summary>Return Levenshtein similarity between two strings
@@ -595,26 +1202,23 @@ public:
 	/// <param name="string2">The other string to compare.</param>
 	/// <returns>The degree of similarity 0 to 1.0, where 0 represents a lack of any
 	/// noteable similarity, and 1 represents equivalent strings.</returns>
-	double Similarity(xstring string1, xstring string2) {
+	double Similarity(xstring_view string1, xstring_view string2) {
 		if (string1.empty()) return (string2.empty()) ? 1 : 0;
 		if (string2.empty()) return 0;
 
 		// if strings of different lengths, ensure shorter string is in string1. This can result in a little
 		// faster speed by spending more time spinning just the inner loop during the main processing.
-		if (string1.size() > string2.size()) { xstring t = string1; string1 = string2; string2 = t; }
+		if (string1.size() > string2.size()) swap(string1, string2);
 
 		// identify common suffix and/or prefix that can be ignored
 		int len1, len2, start;
 		Helpers::PrefixSuffixPrep(string1, string2, len1, len2, start);
 		if (len1 == 0) return 1.0;
 
-		return Helpers::ToSimilarity(Distance(string1, string2, len1, len2, start,
-			(this->baseChar1Costs = (len2 <= this->baseChar1Costs.size()) ? this->baseChar1Costs : vector<int>(len2, 0)))
-			, string2.size());
+		return Helpers::ToSimilarity(MiddleDistance(string1, string2, len1, len2, start, INT_MAX), string2.size());
 	}
 
-
-	/// <summary>Return Levenshtein similarity between two strings 
+	/// <summary>Return Levenshtein similarity between two strings
 	/// (1 - (levenshtein distance / len of longer string)).</summary>
 	/// <param name="string1">One of the strings to compare.</param>
 	/// <param name="string2">The other string to compare.</param>
@@ -623,13 +1227,13 @@ public:
 	/// lower than minSimilarity, otherwise, a number between 0 and 1.0 where 0
 	/// represents a lack of any noteable similarity, and 1 represents equivalent
 	/// strings.</returns>
-	double Similarity(xstring string1, xstring string2, double minSimilarity) {
+	double Similarity(xstring_view string1, xstring_view string2, double minSimilarity) {
 		if (minSimilarity < 0 || minSimilarity > 1) throw "minSimilarity must be in range 0 to 1.0";
 		if (string1.empty() || string2.empty()) return Helpers::NullSimilarityResults(string1, string2, minSimilarity);
 
 		// if strings of different lengths, ensure shorter string is in string1. This can result in a little
 		// faster speed by spending more time spinning just the inner loop during the main processing.
-		if (string1.size() > string2.size()) { xstring t = string1; string1 = string2; string2 = t; }
+		if (string1.size() > string2.size()) swap(string1, string2);
 
 		int iMaxDistance = Helpers::ToDistance(minSimilarity, string2.size());
 		if (string2.size() - string1.size() > iMaxDistance) return -1;
@@ -640,19 +1244,12 @@ public:
 		Helpers::PrefixSuffixPrep(string1, string2, len1, len2, start);
 		if (len1 == 0) return 1.0;
 
-		if (iMaxDistance < len2) {
-			return Helpers::ToSimilarity(Distance(string1, string2, len1, len2, start, iMaxDistance,
-				(this->baseChar1Costs = (len2 <= this->baseChar1Costs.size()) ? this->baseChar1Costs : vector<int>(len2, 0)))
-				, string2.size());
-		}
-		return Helpers::ToSimilarity(Distance(string1, string2, len1, len2, start,
-			(this->baseChar1Costs = (len2 <= this->baseChar1Costs.size()) ? this->baseChar1Costs : vector<int>(len2, 0)))
-			, string2.size());
+		return Helpers::ToSimilarity(MiddleDistance(string1, string2, len1, len2, start, iMaxDistance), string2.size());
 	}
 
 	/// <summary>Internal implementation of the core Levenshtein algorithm.</summary>
 	/// <remarks>https://github.com/softwx/SoftWx.Match</remarks>
-	static int Distance(xstring string1, xstring string2, int len1, int len2, int start, vector<int> &char1Costs) {
+	static int Distance(xstring_view string1, xstring_view string2, int len1, int len2, int start, vector<int> &char1Costs) {
 		for (int j = 0; j < len2; j++) 
 			char1Costs[j] = j + 1;
 		int currentCharCost = 0;
@@ -697,7 +1294,7 @@ public:
 
 	/// <summary>Internal implementation of the core Levenshtein algorithm that accepts a maxDistance.</summary>
 	/// <remarks>https://github.com/softwx/SoftWx.Match</remarks>
-	static int Distance(xstring string1, xstring string2, int len1, int len2, int start, int maxDistance, vector<int> &char1Costs) {
+	static int Distance(xstring_view string1, xstring_view string2, int len1, int len2, int start, int maxDistance, vector<int> &char1Costs) {
 		//            if (maxDistance >= len2) return Distance(string1, string2, len1, len2, start, char1Costs);
 		int i, j;
 		for (j = 0; j < maxDistance; j++) 
@@ -771,71 +1368,1535 @@ enum DistanceAlgorithm {
 class EditDistance {
 private:
 	DistanceAlgorithm algorithm;
-	IDistance* distanceComparer;
 	DamerauOSA damerauOSADistance;
 	Levenshtein levenshteinDistance;
+	BitParallelDistance codePointKernel;
 
 public:
 	/// <summary>Create a new EditDistance object.</summary>
 	/// <param name="algorithm">The desired edit distance algorithm.</param>
 	EditDistance(DistanceAlgorithm algorithm) {
-		this->algorithm = algorithm;
-		switch (algorithm) {
-		case DistanceAlgorithm::DamerauOSADistance:
-			this->distanceComparer = &damerauOSADistance;
-			break;
-		case DistanceAlgorithm::LevenshteinDistance:
-			this->distanceComparer = &levenshteinDistance;
-			break;
-		default:
+		if (algorithm != DistanceAlgorithm::DamerauOSADistance && algorithm != DistanceAlgorithm::LevenshteinDistance)
 			throw "Unknown distance algorithm.";
-		}
+		this->algorithm = algorithm;
 	}
 
+	/// <summary>The selected edit distance algorithm.</summary>
+	DistanceAlgorithm Algorithm() const { return algorithm; }
+
 	/// <summary>Compare a string to the base string to determine the edit distance,
 	/// using the previously selected algorithm.</summary>
+	/// <remarks>The buffers of the algorithm are reused, so an EditDistance object
+	/// must not be used by multiple threads at the same time.</remarks>
 	/// <param name="string2">The string to compare.</param>
 	/// <param name="maxDistance">The maximum distance allowed.</param>
 	/// <returns>The edit distance (or -1 if maxDistance exceeded).</returns>
-	int Compare(xstring string1, xstring string2, int maxDistance) {
-		return (int)this->distanceComparer->Distance(string1, string2, maxDistance);
+	int Compare(xstring_view string1, xstring_view string2, int maxDistance) {
+		if (algorithm == DistanceAlgorithm::DamerauOSADistance)
+			return (int)damerauOSADistance.Distance(string1, string2, maxDistance);
+		return (int)levenshteinDistance.Distance(string1, string2, maxDistance);
 	}
-};
-
-class Node
-{
-public:
-	xstring suggestion;
-	int next;
-};
 
-class Entry
-{
-public:
-	int count;
-	int first;
+	/// <summary>Compare two strings of code points, e.g. decoded UTF-8 text, the same way as Compare.</summary>
+	/// <param name="maxDistance">The maximum distance allowed.</param>
+	/// <returns>The edit distance (or -1 if maxDistance exceeded).</returns>
+	int Compare(u32string_view string1, u32string_view string2, int maxDistance) {
+		if (string1.empty() || string2.empty())
+		{
+			int length = (int)(string1.size() + string2.size());
+			return (length == 0) ? 0 : (length <= maxDistance) ? length : -1;
+		}
+		if (maxDistance <= 0) return (string1 == string2) ? 0 : -1;
+		if (string1.size() > string2.size()) swap(string1, string2);
+		if ((int)(string2.size() - string1.size()) > maxDistance) return -1;
+		codePointKernel.SetPattern(string1);
+		return codePointKernel.Distance(string2, algorithm == DistanceAlgorithm::DamerauOSADistance, maxDistance);
+	}
 };
 
-/// <summary>An intentionally opacque class used to temporarily stage
-/// dictionary data during the adding of many words. By staging the
-/// data during the building of the dictionary data, significant savings
-/// of time can be achieved, as well as a reduction in final memory usage.</summary>
-class SuggestionStage
+/// <summary>An open addressing set of 32-bit keys for scratch use. Clear() starts a new
+/// generation instead of touching the slots, so a set that is reused does not allocate
+/// once it has grown to its working size.</summary>
+class ScratchSet
 {
 private:
-	Dictionary<int, Entry> Deletes;
-	ChunkArray<Node> Nodes;
+	vector<uint32_t> keys;
+	vector<uint32_t> hashes;
+	vector<uint32_t> generations; // a slot is used if its generation is the current one
+	uint32_t generation = 1;
+	uint32_t mask = 0;
+	int shift = 32;
+	size_t count = 0;
+
+	// Fibonacci hashing, so that hashes with poorly distributed low bits still spread
+	uint32_t Slot(uint32_t hash) const { return (uint32_t)(hash * 2654435769u) >> shift; }
+
+	void Grow()
+	{
+		vector<uint32_t> oldKeys, oldHashes, oldGenerations;
+		oldKeys.swap(keys);
+		oldHashes.swap(hashes);
+		oldGenerations.swap(generations);
+		size_t capacity = max((size_t)64, oldKeys.size() * 2);
+		keys.resize(capacity);
+		hashes.resize(capacity);
+		generations.assign(capacity, 0);
+		mask = (uint32_t)capacity - 1;
+		shift = 32;
+		for (size_t c = capacity; c > 1; c >>= 1) shift--;
+		for (size_t j = 0; j < oldKeys.size(); j++)
+		{
+			if (oldGenerations[j] != generation) continue;
+			uint32_t i = Slot(oldHashes[j]);
+			while (generations[i] == generation) i = (i + 1) & mask;
+			keys[i] = oldKeys[j];
+			hashes[i] = oldHashes[j];
+			generations[i] = generation;
+		}
+	}
 
 public:
-	/// <summary>Create a new instance of SuggestionStage.</summary>
-	/// <remarks>Specifying ann accurate initialCapacity is not essential, 
-	/// but it can help speed up processing by alleviating the need for 
-	/// data restructuring as the size grows.</remarks>
-	/// <param name="initialCapacity">The expected number of words that will be added.</param>
-	SuggestionStage(int initialCapacity)
+	/// <summary>Remove all keys.</summary>
+	void Clear()
 	{
-		Deletes.reserve(initialCapacity);
-		Nodes.Reserve(initialCapacity * 2);
+		count = 0;
+		if (++generation == 0)
+		{
+			std::fill(generations.begin(), generations.end(), 0);
+			generation = 1;
+		}
+	}
+
+	/// <summary>Number of keys in the set.</summary>
+	size_t Size() const { return count; }
+
+	/// <summary>Add a key, unless an equal key is already in the set.</summary>
+	/// <param name="hash">Hash of the key.</param>
+	/// <param name="key">The key.</param>
+	/// <param name="equal">Called with keys of the same hash, returns true if it equals key.</param>
+	/// <returns>True if the key was added.</returns>
+	template <class Equal>
+	bool Insert(uint32_t hash, uint32_t key, Equal equal)
+	{
+		if ((count + 1) * 2 > keys.size()) Grow();
+		uint32_t i = Slot(hash);
+		for (; generations[i] == generation; i = (i + 1) & mask)
+		{
+			if (hashes[i] == hash && equal(keys[i])) return false;
+		}
+		keys[i] = key;
+		hashes[i] = hash;
+		generations[i] = generation;
+		count++;
+		return true;
+	}
+
+	/// <summary>Add a key that is its own hash, unless it is already in the set.</summary>
+	/// <returns>True if the key was added.</returns>
+	bool Insert(uint32_t key)
+	{
+		return Insert(key, key, [key](uint32_t other) { return other == key; });
+	}
+};
+
+/// <summary>Polynomial hashes of the prefixes of a string, from which the hash of any substring,
+/// and of the string with some of its chars deleted, is derived in constant time.</summary>
+/// <remarks>The hash of s is the sum of (s[i] + 1) * Base^(n-1-i) modulo 2^64. The hash of the
+/// substring [begin, end) is prefix[end] - prefix[begin] * Base^(end-begin), and the hash of a
+/// concatenation s1 + s2 is Hash(s1) * Base^|s2| + Hash(s2).</remarks>
+class PrefixHashes
+{
+private:
+	vector<uint64_t> prefix{ 0 };
+	vector<uint64_t> powers{ 1 };
+
+public:
+	static const uint64_t Base = 0x9E3779B97F4A7C15ULL;
+
+	/// <summary>Polynomial hash of a string of chars or code points.</summary>
+	/// <remarks>Chars are hashed by code, so a string of chars and its code points hash the same if they are all ASCII.</remarks>
+	template <class Char>
+	static uint64_t Of(basic_string_view<Char> s)
+	{
+		uint64_t hash = 0;
+		for (Char c : s) hash = hash * Base + (uint64_t)(typename make_unsigned<Char>::type)c + 1;
+		return hash;
+	}
+
+	static uint64_t Of(xstring_view s) { return Of<xchar>(s); }
+
+	/// <summary>Compute the prefix hashes of a string of chars or code points. Reuses the buffers of earlier strings.</summary>
+	template <class Char>
+	void Assign(basic_string_view<Char> s)
+	{
+		prefix.resize(s.size() + 1);
+		for (size_t i = 0; i < s.size(); i++) prefix[i + 1] = prefix[i] * Base + (uint64_t)(typename make_unsigned<Char>::type)s[i] + 1;
+		while (powers.size() <= s.size()) powers.push_back(powers.back() * Base);
+	}
+
+	void Assign(xstring_view s) { Assign<xchar>(s); }
+
+	/// <summary>Length of the string.</summary>
+	int Size() const { return (int)prefix.size() - 1; }
+
+	/// <summary>Base^n, for n up to the length of the string.</summary>
+	uint64_t Power(int n) const { return powers[n]; }
+
+	/// <summary>Hash of the substring [begin, end).</summary>
+	uint64_t Substring(int begin, int end) const { return prefix[end] - prefix[begin] * powers[end - begin]; }
+
+	/// <summary>Hash of the string without the char at index.</summary>
+	uint64_t Delete(int index) const
+	{
+		int n = Size();
+		return prefix[index] * powers[n - 1 - index] + Substring(index + 1, n);
+	}
+};
+
+/// <summary>An allocator that counts the bytes allocated and not yet freed through it and its copies.</summary>
+/// <remarks>Used by the hash maps of a SymSpell built with SYMSPELL_TRACK_MEMORY, so that MemoryReport
+/// returns the exact size of their nodes and buckets instead of an estimate.</remarks>
+template <class T>
+class CountingAllocator
+{
+public:
+	typedef T value_type;
+	typedef true_type propagate_on_container_move_assignment;
+	typedef true_type propagate_on_container_swap;
+
+	// shared by all copies and rebinds, so that the nodes and buckets of a map are counted together
+	shared_ptr<atomic<size_t>> bytes;
+
+	CountingAllocator() : bytes(make_shared<atomic<size_t>>(0)) {}
+
+	template <class U>
+	CountingAllocator(const CountingAllocator<U>& other) : bytes(other.bytes) {}
+
+	// a copied map counts its own bytes
+	CountingAllocator select_on_container_copy_construction() const { return CountingAllocator(); }
+
+	T* allocate(size_t n)
+	{
+		T* p = allocator<T>().allocate(n);
+		bytes->fetch_add(n * sizeof(T), memory_order_relaxed);
+		return p;
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		bytes->fetch_sub(n * sizeof(T), memory_order_relaxed);
+		allocator<T>().deallocate(p, n);
+	}
+
+	/// <summary>Bytes allocated and not yet freed.</summary>
+	size_t Bytes() const { return bytes->load(memory_order_relaxed); }
+
+	template <class U>
+	bool operator==(const CountingAllocator<U>& other) const { return bytes == other.bytes; }
+
+	template <class U>
+	bool operator!=(const CountingAllocator<U>& other) const { return bytes != other.bytes; }
+};
+
+#ifdef SYMSPELL_TRACK_MEMORY
+template <class K, class V>
+using MeasuredDictionary = Dictionary<K, V, hash<K>, equal_to<K>, CountingAllocator<pair<const K, V>>>;
+#else
+template <class K, class V>
+using MeasuredDictionary = Dictionary<K, V>;
+#endif
+
+/// <summary>Bytes of the nodes and buckets of a hash map, without memory its keys and values refer to.</summary>
+/// <remarks>Exact if the map counts its allocations, otherwise estimated from the node layout of common
+/// standard libraries: the next pointer, the element and the cached hash.</remarks>
+template <class K, class V, class A>
+size_t MapBytes(const Dictionary<K, V, hash<K>, equal_to<K>, A>& map)
+{
+	if constexpr (is_same<A, CountingAllocator<pair<const K, V>>>::value) return map.get_allocator().Bytes();
+	else return map.size() * (sizeof(void*) + sizeof(pair<const K, V>) + sizeof(size_t)) + (map.bucket_count() > 1 ? map.bucket_count() * sizeof(void*) : 0);
+}
+
+/// <summary>Bytes a string allocated for its chars, 0 if they are stored within the string object.</summary>
+static inline size_t StringBytes(const xstring& s)
+{
+	const char* data = (const char*)s.data();
+	if (data >= (const char*)&s && data < (const char*)(&s + 1)) return 0;
+	return (s.capacity() + 1) * sizeof(xchar);
+}
+
+/// <summary>A contiguous array that either owns its elements, or refers to read-only
+/// memory owned by someone else, e.g. a memory mapped snapshot file.</summary>
+/// <remarks>Read access works the same in both cases. Edit() copies referenced elements
+/// into owned memory before the first modification (copy on write).</remarks>
+template <class T>
+class FlatArray
+{
+private:
+	vector<T> owned;
+	const T* items = nullptr; // referenced elements, if external
+	size_t count = 0;
+	bool external = false;
+
+public:
+	FlatArray() {}
+
+	FlatArray(initializer_list<T> values) : owned(values) {}
+
+	const T* data() const { return external ? items : owned.data(); }
+	size_t size() const { return external ? count : owned.size(); }
+	bool empty() const { return size() == 0; }
+	const T& operator[](size_t index) const { return data()[index]; }
+	const T* begin() const { return data(); }
+	const T* end() const { return data() + size(); }
+
+	/// <summary>True if the elements are referenced, not owned.</summary>
+	bool IsExternal() const { return external; }
+
+	/// <summary>Bytes of the owned elements, including reserved capacity.</summary>
+	size_t HeapBytes() const { return owned.capacity() * sizeof(T); }
+
+	/// <summary>Bytes of the referenced elements.</summary>
+	size_t MappedBytes() const { return external ? count * sizeof(T) : 0; }
+
+	/// <summary>Refer to elements owned by someone else, who must keep them alive and unchanged.</summary>
+	void Attach(const T* values, size_t size)
+	{
+		vector<T>().swap(owned);
+		items = values;
+		count = size;
+		external = true;
+	}
+
+	/// <summary>Get the owned elements for modification.</summary>
+	vector<T>& Edit()
+	{
+		if (external)
+		{
+			owned.assign(items, items + count);
+			items = nullptr;
+			count = 0;
+			external = false;
+		}
+		return owned;
+	}
+};
+
+/// <summary>A minimal perfect hash function of a set of 64-bit key hashes, after BBHash (Limasset et al. 2017).</summary>
+/// <remarks>Keys are placed in a cascade of bit arrays: a key takes the bit its hash selects in the first array
+/// where no other remaining key selects the same bit, and its index is the number of set bits before it.
+/// With arrays of 2 bits per remaining key this takes about 3.7 bits per key, plus 1.9 bits for the ranks,
+/// and most keys are found in the first or second array. A key that is not in the set maps to some index or to none, so the caller compares
+/// the key stored at the index.</remarks>
+class PerfectHash
+{
+private:
+	static const int MaxLevels = 64;
+
+	FlatArray<uint64_t> bits; // the bit arrays of all levels, back to back
+	FlatArray<uint64_t> levels; // first bit of every level, and the total number of bits
+	FlatArray<uint32_t> ranks; // number of set bits before every 64-bit word, so that a rank takes one popcount
+
+	// the key hash mixed once (splitmix64 finalizer), so that a multiplication gives the hash of a level
+	static uint64_t Mix(uint64_t hash)
+	{
+		hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+		return hash ^ (hash >> 31);
+	}
+
+	// a hash of the mixed key for every level: the rotation makes keys that collide in one level collide
+	// independently in the next one, which multiples of the key would not
+	static uint64_t LevelHash(uint64_t mixed, uint64_t level)
+	{
+		int rotation = (int)(level * 23 % 64);
+		uint64_t rotated = rotation == 0 ? mixed : (mixed << rotation) | (mixed >> (64 - rotation));
+		return rotated * 0x9E3779B97F4A7C15ULL;
+	}
+
+	// bit of a level of size bits (less than 2^32) selected by a hash, without a division
+	static uint64_t Reduce(uint64_t hash, uint64_t size) { return ((hash >> 32) * size) >> 32; }
+
+	static int PopCount(uint64_t x)
+	{
+#ifdef _MSC_VER
+		return (int)__popcnt64(x);
+#else
+		return __builtin_popcountll(x);
+#endif
+	}
+
+	// number of set bits before a bit
+	uint64_t Rank(uint64_t position) const
+	{
+		return ranks[position >> 6] + PopCount(bits[position >> 6] & ((1ULL << (position & 63)) - 1));
+	}
+
+public:
+	/// <summary>True if no function was built.</summary>
+	bool Empty() const { return levels.empty(); }
+
+	/// <summary>Build the function of a set of distinct key hashes.</summary>
+	/// <returns>False if the keys could not be placed, which only happens if hashes repeat.</returns>
+	bool Build(vector<uint64_t> keys)
+	{
+		for (uint64_t& key : keys) key = Mix(key);
+		vector<uint64_t> allBits, levelStarts = { 0 }, seen, collided, next;
+		for (uint64_t level = 0; !keys.empty(); level++)
+		{
+			if (level == MaxLevels) return false;
+			uint64_t size = max((uint64_t)64, (keys.size() * 2 + 63) / 64 * 64);
+			seen.assign(size / 64, 0);
+			collided.assign(size / 64, 0);
+			for (uint64_t key : keys)
+			{
+				uint64_t position = Reduce(LevelHash(key, level), size);
+				uint64_t bit = 1ULL << (position & 63);
+				if (seen[position >> 6] & bit) collided[position >> 6] |= bit;
+				else seen[position >> 6] |= bit;
+			}
+			for (size_t word = 0; word < seen.size(); word++) seen[word] &= ~collided[word];
+			// keys that share their bit with another key try again in the next level
+			next.clear();
+			for (uint64_t key : keys)
+			{
+				uint64_t position = Reduce(LevelHash(key, level), size);
+				if (!(seen[position >> 6] & (1ULL << (position & 63)))) next.push_back(key);
+			}
+			keys.swap(next);
+			allBits.insert(allBits.end(), seen.begin(), seen.end());
+			levelStarts.push_back(levelStarts.back() + size);
+		}
+		vector<uint32_t> wordRanks(allBits.size());
+		uint32_t rank = 0;
+		for (size_t word = 0; word < allBits.size(); word++)
+		{
+			wordRanks[word] = rank;
+			rank += PopCount(allBits[word]);
+		}
+		bits.Edit() = move(allBits);
+		levels.Edit() = move(levelStarts);
+		ranks.Edit() = move(wordRanks);
+		return true;
+	}
+
+	/// <summary>Forget the function.</summary>
+	void Clear()
+	{
+		bits = FlatArray<uint64_t>();
+		levels = FlatArray<uint64_t>();
+		ranks = FlatArray<uint32_t>();
+	}
+
+	/// <summary>Index of a key hash.</summary>
+	/// <returns>The index in [0, number of keys) of a key of the set, and the index of some key or -1 for other keys.</returns>
+	int64_t Find(uint64_t hash) const
+	{
+		uint64_t mixed = Mix(hash);
+		for (size_t level = 0; level + 1 < levels.size(); level++)
+		{
+			uint64_t position = levels[level] + Reduce(LevelHash(mixed, level), levels[level + 1] - levels[level]);
+			if ((bits[position >> 6] >> (position & 63)) & 1) return (int64_t)Rank(position);
+		}
+		return -1;
+	}
+
+	/// <summary>Bytes of the owned bit arrays and ranks.</summary>
+	size_t HeapBytes() const { return bits.HeapBytes() + levels.HeapBytes() + ranks.HeapBytes(); }
+
+	/// <summary>Bytes referenced in a snapshot.</summary>
+	size_t MappedBytes() const { return bits.MappedBytes() + levels.MappedBytes() + ranks.MappedBytes(); }
+
+	/// <summary>Write the function to, or attach it to, a snapshot.</summary>
+	/// <remarks>The archive provides Array(FlatArray&lt;T&gt;&amp;).</remarks>
+	template <class Archive>
+	void Serialize(Archive& archive)
+	{
+		archive.Array(bits);
+		archive.Array(levels);
+		archive.Array(ranks);
+	}
+
+	/// <summary>Check that the arrays, e.g. attached to a snapshot, are consistent, so that Find stays within
+	/// the bit arrays and returns indexes below keyCount.</summary>
+	bool Validate(size_t keyCount) const
+	{
+		if (levels.empty()) return bits.empty() && ranks.empty();
+		if (levels[0] != 0 || levels.size() > MaxLevels + 1 || ranks.size() != bits.size() || levels[levels.size() - 1] != (uint64_t)bits.size() * 64) return false;
+		for (size_t level = 0; level + 1 < levels.size(); level++)
+		{
+			if (levels[level + 1] <= levels[level]) return false;
+			uint64_t size = levels[level + 1] - levels[level];
+			if (size % 64 != 0 || (size >> 32) != 0) return false;
+		}
+		uint64_t rank = 0;
+		for (size_t word = 0; word < bits.size(); word++)
+		{
+			if (ranks[word] != rank) return false;
+			rank += PopCount(bits[word]);
+		}
+		return rank == keyCount;
+	}
+};
+
+/// <summary>A set of unique words with their frequency counts. Every word is stored once
+/// in a contiguous character arena and is identified by a dense 32-bit id, assigned in
+/// insertion order, that other structures (e.g. the delete index) can refer to.</summary>
+/// <remarks>A removed word keeps its id and chars, so that the ids of other words stay valid,
+/// but is no longer found, until Compact numbers the remaining words again. Adding it again assigns a new id. A table that no longer changes can be
+/// frozen, which numbers the words in the order of a minimal perfect hash of them, so that it needs no hash slots.</remarks>
+class WordTable
+{
+private:
+	static const int64_t RemovedCount = INT64_MIN; // count of a removed word
+
+	FlatArray<xchar> chars; // all words back to back, without terminators
+	FlatArray<uint32_t> offsets = { 0 }; // word id i occupies chars[offsets[i]..offsets[i+1])
+	FlatArray<int64_t> counts;
+	FlatArray<uint32_t> slots; // open addressing hash table of word id + 1, 0 = empty slot
+	uint32_t mask = 0;
+	uint64_t removed = 0;
+	PerfectHash perfect; // if frozen: the perfect hash of the words, which gives the word id
+
+	// FNV-1a, stable across platforms and standard libraries so that snapshots stay valid;
+	// chars are hashed unsigned, as char is signed on some platforms and unsigned on others
+	static uint32_t Hash(xstring_view term)
+	{
+		uint32_t hash = 2166136261;
+		for (xchar c : term)
+		{
+			hash ^= (uint32_t)(make_unsigned<xchar>::type)c;
+			hash *= 16777619;
+		}
+		return hash;
+	}
+
+	// 64-bit FNV-1a, the key of the perfect hash
+	static uint64_t Hash64(xstring_view term)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for (xchar c : term)
+		{
+			hash ^= (uint64_t)(make_unsigned<xchar>::type)c;
+			hash *= 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	// go back from the perfect hash to hash slots, to change the table
+	void Thaw()
+	{
+		perfect.Clear();
+		Rehash(counts.size());
+	}
+
+	void Rehash(size_t capacity)
+	{
+		uint32_t newCapacity = 16;
+		while (newCapacity < capacity * 2) newCapacity <<= 1;
+		vector<uint32_t>& table = slots.Edit();
+		table.assign(newCapacity, 0);
+		mask = newCapacity - 1;
+		for (uint32_t id = 0; id < counts.size(); id++)
+		{
+			if (counts[id] == RemovedCount) continue;
+			uint32_t i = Hash(Term(id)) & mask;
+			while (table[i] != 0) i = (i + 1) & mask;
+			table[i] = id + 1;
+		}
+	}
+
+public:
+	/// <summary>Reserve space for the expected number of words.</summary>
+	void Reserve(size_t capacity)
+	{
+		if (Frozen()) Thaw();
+		offsets.Edit().reserve(capacity + 1);
+		counts.Edit().reserve(capacity);
+		if (capacity * 2 > slots.size()) Rehash(capacity);
+	}
+
+	/// <summary>Number of ids assigned, including those of removed words.</summary>
+	size_t Size() const { return counts.size(); }
+
+	/// <summary>Number of words in the table, without removed words.</summary>
+	size_t LiveCount() const { return counts.size() - (size_t)removed; }
+
+	/// <summary>True if the words are found by a perfect hash, see Freeze.</summary>
+	bool Frozen() const { return !perfect.Empty(); }
+
+	/// <summary>Bytes of the owned chars, offsets, counts and hash slots or perfect hash.</summary>
+	size_t HeapBytes() const { return chars.HeapBytes() + offsets.HeapBytes() + counts.HeapBytes() + slots.HeapBytes() + perfect.HeapBytes(); }
+
+	/// <summary>Bytes referenced in a snapshot.</summary>
+	size_t MappedBytes() const { return chars.MappedBytes() + offsets.MappedBytes() + counts.MappedBytes() + slots.MappedBytes() + perfect.MappedBytes(); }
+
+	/// <summary>Replace the hash slots by a minimal perfect hash of the words, and number the words in its order,
+	/// so that finding a word takes one hash and at most one comparison, and about 6 bits per word.</summary>
+	/// <remarks>Removed words are dropped. The next Add or Remove goes back to hash slots, and keeps the ids.</remarks>
+	/// <returns>The new id of every old id, or UINT32_MAX for removed words; empty if the ids did not change.</returns>
+	vector<uint32_t> Freeze()
+	{
+		if (Frozen()) return vector<uint32_t>();
+		vector<uint64_t> hashes;
+		vector<uint32_t> ids;
+		for (uint32_t id = 0; id < counts.size(); id++)
+		{
+			if (counts[id] == RemovedCount) continue;
+			hashes.push_back(Hash64(Term(id)));
+			ids.push_back(id);
+		}
+		PerfectHash built;
+		if (!built.Build(hashes)) return vector<uint32_t>();
+		vector<uint32_t> renumbered(counts.size(), UINT32_MAX);
+		for (size_t i = 0; i < ids.size(); i++) renumbered[ids[i]] = (uint32_t)built.Find(hashes[i]);
+		// the chars, offsets and counts in the order of the new ids
+		vector<xchar> newChars;
+		vector<uint32_t> newOffsets(ids.size() + 1);
+		vector<int64_t> newCounts(ids.size());
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			newOffsets[renumbered[ids[i]] + 1] = Length(ids[i]);
+			newCounts[renumbered[ids[i]]] = counts[ids[i]];
+		}
+		for (size_t id = 0; id < ids.size(); id++) newOffsets[id + 1] += newOffsets[id];
+		newChars.resize(newOffsets[ids.size()]);
+		for (uint32_t id : ids)
+		{
+			xstring_view term = Term(id);
+			std::copy(term.begin(), term.end(), newChars.begin() + newOffsets[renumbered[id]]);
+		}
+		chars = FlatArray<xchar>();
+		chars.Edit() = move(newChars);
+		offsets = FlatArray<uint32_t>();
+		offsets.Edit() = move(newOffsets);
+		counts = FlatArray<int64_t>();
+		counts.Edit() = move(newCounts);
+		removed = 0;
+		perfect = move(built);
+		slots = FlatArray<uint32_t>();
+		mask = 0;
+		return renumbered;
+	}
+
+	/// <summary>Find the id of a word.</summary>
+	/// <returns>The word id, or -1 if the word is not in the table.</returns>
+	int64_t Find(xstring_view term) const
+	{
+		if (Frozen())
+		{
+			int64_t id = perfect.Find(Hash64(term));
+			if (id < 0 || (size_t)id >= counts.size()) return -1;
+			return Term((uint32_t)id) == term ? id : -1;
+		}
+		if (slots.empty()) return -1;
+		const uint32_t* table = slots.data();
+		for (uint32_t i = Hash(term) & mask; table[i] != 0; i = (i + 1) & mask)
+		{
+			uint32_t id = table[i] - 1;
+			if (Term(id) == term) return id;
+		}
+		return -1;
+	}
+
+	/// <summary>Add a word that is not yet in the table.</summary>
+	/// <returns>The id of the new word.</returns>
+	uint32_t Add(xstring_view term, int64_t count)
+	{
+		if (Frozen()) Thaw();
+		if ((counts.size() + 1) * 2 > slots.size()) Rehash(max((size_t)16, counts.size() * 2));
+		uint32_t id = (uint32_t)counts.size();
+		vector<xchar>& arena = chars.Edit();
+		arena.insert(arena.end(), term.begin(), term.end());
+		offsets.Edit().push_back((uint32_t)arena.size());
+		counts.Edit().push_back(count);
+		vector<uint32_t>& table = slots.Edit();
+		uint32_t i = Hash(term) & mask;
+		while (table[i] != 0) i = (i + 1) & mask;
+		table[i] = id + 1;
+		return id;
+	}
+
+	/// <summary>The word with the given id. The view is invalidated by the next Add.</summary>
+	xstring_view Term(uint32_t id) const { return xstring_view(chars.data() + offsets[id], offsets[id + 1] - offsets[id]); }
+
+	/// <summary>Length of the word with the given id.</summary>
+	int Length(uint32_t id) const { return offsets[id + 1] - offsets[id]; }
+
+	/// <summary>Frequency count of the word with the given id.</summary>
+	int64_t Count(uint32_t id) const { return counts[id]; }
+
+	void SetCount(uint32_t id, int64_t count) { counts.Edit()[id] = count; }
+
+	/// <summary>Remove the word with the given id, which must be in the table.</summary>
+	void Remove(uint32_t id)
+	{
+		if (Frozen()) Thaw();
+		vector<uint32_t>& table = slots.Edit();
+		uint32_t i = Hash(Term(id)) & mask;
+		while (table[i] != id + 1) i = (i + 1) & mask;
+		// backward shift deletion: move later words of the probe sequence into the gap, unless
+		// that would put them before their home slot
+		for (uint32_t j = i; ; )
+		{
+			table[i] = 0;
+			for (;;)
+			{
+				j = (j + 1) & mask;
+				if (table[j] == 0)
+				{
+					counts.Edit()[id] = RemovedCount;
+					removed++;
+					return;
+				}
+				uint32_t home = Hash(Term(table[j] - 1)) & mask;
+				if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) continue;
+				break;
+			}
+			table[i] = table[j];
+			i = j;
+		}
+	}
+
+	/// <summary>Number of ids of removed words, which are reclaimed by Compact.</summary>
+	size_t RemovedWords() const { return (size_t)removed; }
+
+	/// <summary>Bytes of the chars, offsets and counts that removed words still hold.</summary>
+	size_t RemovedBytes() const
+	{
+		if (removed == 0) return 0;
+		size_t bytes = 0;
+		for (uint32_t id = 0; id < counts.size(); id++)
+		{
+			if (counts[id] == RemovedCount) bytes += Length(id) * sizeof(xchar) + sizeof(uint32_t) + sizeof(int64_t);
+		}
+		return bytes;
+	}
+
+	/// <summary>Drop the ids, chars, offsets and counts of removed words, and number the other words
+	/// again from 0, in the same order. A frozen table has no removed words, see Freeze.</summary>
+	/// <returns>The new id of every old id, or UINT32_MAX for removed words.</returns>
+	vector<uint32_t> Compact()
+	{
+		vector<uint32_t> renumbered(counts.size(), UINT32_MAX);
+		vector<xchar> newChars;
+		vector<uint32_t> newOffsets = { 0 };
+		vector<int64_t> newCounts;
+		newOffsets.reserve(LiveCount() + 1);
+		newCounts.reserve(LiveCount());
+		for (uint32_t id = 0; id < counts.size(); id++)
+		{
+			if (counts[id] == RemovedCount) continue;
+			renumbered[id] = (uint32_t)newCounts.size();
+			xstring_view term = Term(id);
+			newChars.insert(newChars.end(), term.begin(), term.end());
+			newOffsets.push_back((uint32_t)newChars.size());
+			newCounts.push_back(counts[id]);
+		}
+		chars = FlatArray<xchar>();
+		chars.Edit() = move(newChars);
+		offsets = FlatArray<uint32_t>();
+		offsets.Edit() = move(newOffsets);
+		counts = FlatArray<int64_t>();
+		counts.Edit() = move(newCounts);
+		removed = 0;
+		Rehash(counts.size());
+		return renumbered;
+	}
+
+	/// <summary>Write the table to, or attach it to, a snapshot.</summary>
+	/// <remarks>The archive provides Array(FlatArray&lt;T&gt;&amp;) and Value(T&amp;).</remarks>
+	template <class Archive>
+	void Serialize(Archive& archive)
+	{
+		archive.Array(chars);
+		archive.Array(offsets);
+		archive.Array(counts);
+		archive.Array(slots);
+		archive.Value(removed);
+		perfect.Serialize(archive);
+		mask = slots.empty() ? 0 : (uint32_t)slots.size() - 1;
+	}
+
+	/// <summary>Check that the arrays of the table, e.g. attached to a snapshot, are consistent, so that
+	/// no lookup reads out of bounds, and that every word is found by its hash slot or perfect hash.</summary>
+	bool Validate() const
+	{
+		size_t size = counts.size();
+		if (size >= UINT32_MAX || offsets.size() != size + 1 || offsets[0] != 0 || offsets[size] != chars.size()) return false;
+		uint64_t removedCount = 0;
+		for (size_t id = 0; id < size; id++)
+		{
+			if (offsets[id] > offsets[id + 1]) return false;
+			if (counts[id] == RemovedCount) removedCount++;
+		}
+		if (removedCount != removed) return false;
+		if (Frozen())
+		{
+			// the words are numbered in the order of the perfect hash, without removed words
+			if (!slots.empty() || removed != 0 || !perfect.Validate(size)) return false;
+			for (uint32_t id = 0; id < size; id++)
+			{
+				if (Find(Term(id)) != (int64_t)id) return false;
+			}
+			return true;
+		}
+		if (slots.empty()) return LiveCount() == 0;
+		// a power of two, with an empty slot that ends every probe sequence
+		if ((slots.size() & (slots.size() - 1)) != 0 || LiveCount() >= slots.size()) return false;
+		size_t occupied = 0;
+		for (uint32_t slot : slots)
+		{
+			if (slot == 0) continue;
+			if (slot > size || counts[slot - 1] == RemovedCount) return false;
+			occupied++;
+		}
+		if (occupied != LiveCount()) return false;
+		for (uint32_t slot : slots)
+		{
+			if (slot != 0 && Find(Term(slot - 1)) != (int64_t)slot - 1) return false;
+		}
+		return true;
+	}
+};
+
+/// <summary>Bigram frequency counts, keyed by the pair of ids of their two words.</summary>
+/// <remarks>The words of the bigrams are stored once each in a WordTable. The second word ids
+/// of every first word id are a sorted range of one shared array (compressed sparse rows), so a
+/// bigram is found by two word lookups and a binary search, without building "word1 word2".
+/// Counts are stored in 32 bits; the few counts that need more are stored separately, and are
+/// referred to by their index. Additions are merged in bulk by rebuilding the arrays.</remarks>
+class BigramTable
+{
+public:
+	/// <summary>A bigram that is staged for Merge.</summary>
+	struct Bigram
+	{
+		uint32_t first;
+		uint32_t second;
+		int64_t count;
+	};
+
+private:
+	static const uint32_t LargeCount = 0x80000000u;
+
+	WordTable words; // the words of the bigrams
+	FlatArray<uint32_t> starts = { 0 }; // the bigrams of first word id i occupy seconds[starts[i]..starts[i+1])
+	FlatArray<uint32_t> seconds; // second word ids, ascending within the range of a first word id
+	FlatArray<uint32_t> counts; // count, or LargeCount + index of the count in largeCounts
+	FlatArray<int64_t> largeCounts;
+
+	static uint32_t Encode(int64_t count, vector<int64_t>& large)
+	{
+		if (count >= 0 && count < LargeCount) return (uint32_t)count;
+		large.push_back(count);
+		return LargeCount + (uint32_t)(large.size() - 1);
+	}
+
+	int64_t Decode(uint32_t count) const { return (count & LargeCount) ? largeCounts[count - LargeCount] : count; }
+
+	// range of the second word ids of a first word id
+	const uint32_t* Range(uint32_t first, const uint32_t*& end) const
+	{
+		if (first + 1 >= starts.size())
+		{
+			end = nullptr;
+			return nullptr;
+		}
+		end = seconds.data() + starts[first + 1];
+		return seconds.data() + starts[first];
+	}
+
+public:
+	/// <summary>Number of bigrams in the table.</summary>
+	size_t Size() const { return seconds.size(); }
+
+	/// <summary>Number of distinct words of the bigrams.</summary>
+	size_t WordCount() const { return words.Size(); }
+
+	/// <summary>Find the words of the bigrams by a minimal perfect hash, until a bigram of a new word is staged, see WordTable::Freeze.</summary>
+	/// <remarks>The rows are rebuilt for the new word ids.</remarks>
+	void Freeze()
+	{
+		vector<uint32_t> renumbered = words.Freeze();
+		if (renumbered.empty()) return;
+		vector<uint32_t> oldIds(words.Size());
+		for (uint32_t id = 0; id < renumbered.size(); id++) oldIds[renumbered[id]] = id;
+		vector<uint32_t> newStarts(words.Size() + 1);
+		vector<uint32_t> newSeconds, newCounts;
+		newSeconds.reserve(seconds.size());
+		newCounts.reserve(counts.size());
+		vector<pair<uint32_t, uint32_t>> row;
+		for (uint32_t first = 0; first < words.Size(); first++)
+		{
+			newStarts[first] = (uint32_t)newSeconds.size();
+			const uint32_t* end;
+			const uint32_t* begin = Range(oldIds[first], end);
+			row.clear();
+			for (const uint32_t* second = begin; second != end; second++) row.push_back(pair<uint32_t, uint32_t>(renumbered[*second], counts[second - seconds.data()]));
+			sort(row.begin(), row.end());
+			for (const pair<uint32_t, uint32_t>& bigram : row)
+			{
+				newSeconds.push_back(bigram.first);
+				newCounts.push_back(bigram.second);
+			}
+		}
+		newStarts[words.Size()] = (uint32_t)newSeconds.size();
+		starts = FlatArray<uint32_t>();
+		starts.Edit() = move(newStarts);
+		seconds = FlatArray<uint32_t>();
+		seconds.Edit() = move(newSeconds);
+		counts = FlatArray<uint32_t>();
+		counts.Edit() = move(newCounts);
+	}
+
+	/// <summary>Bytes of the owned words, rows and counts.</summary>
+	size_t HeapBytes() const { return words.HeapBytes() + starts.HeapBytes() + seconds.HeapBytes() + counts.HeapBytes() + largeCounts.HeapBytes(); }
+
+	/// <summary>Bytes referenced in a snapshot.</summary>
+	size_t MappedBytes() const { return words.MappedBytes() + starts.MappedBytes() + seconds.MappedBytes() + counts.MappedBytes() + largeCounts.MappedBytes(); }
+
+	/// <summary>Find the count of a bigram.</summary>
+	/// <param name="count">Receives the count, if the bigram is in the table.</param>
+	/// <returns>True if the bigram is in the table.</returns>
+	bool Find(xstring_view first, xstring_view second, int64_t& count) const
+	{
+		int64_t firstId = words.Find(first);
+		if (firstId < 0) return false;
+		int64_t secondId = words.Find(second);
+		if (secondId < 0) return false;
+		const uint32_t* end;
+		const uint32_t* begin = Range((uint32_t)firstId, end);
+		const uint32_t* found = lower_bound(begin, end, (uint32_t)secondId);
+		if (found == end || *found != (uint32_t)secondId) return false;
+		count = Decode(counts[found - seconds.data()]);
+		return true;
+	}
+
+	/// <summary>Stage a bigram for Merge, adding its words to the table.</summary>
+	void Stage(xstring_view first, xstring_view second, int64_t count, vector<Bigram>& staged)
+	{
+		int64_t firstId = words.Find(first);
+		if (firstId < 0) firstId = words.Add(first, 0);
+		int64_t secondId = words.Find(second);
+		if (secondId < 0) secondId = words.Add(second, 0);
+		staged.push_back({ (uint32_t)firstId, (uint32_t)secondId, count });
+	}
+
+	/// <summary>Rebuild the table with staged bigrams added.</summary>
+	/// <remarks>A bigram that is in the table already, or was staged before, keeps its first count.</remarks>
+	void Merge(vector<Bigram>& staged)
+	{
+		if (staged.empty()) return;
+		stable_sort(staged.begin(), staged.end(), [](const Bigram& l, const Bigram& r)
+		{
+			return (l.first != r.first) ? l.first < r.first : l.second < r.second;
+		});
+		staged.erase(unique(staged.begin(), staged.end(), [](const Bigram& l, const Bigram& r)
+		{
+			return l.first == r.first && l.second == r.second;
+		}), staged.end());
+
+		BigramTable merged;
+		vector<uint32_t>& newStarts = merged.starts.Edit();
+		vector<uint32_t>& newSeconds = merged.seconds.Edit();
+		vector<uint32_t>& newCounts = merged.counts.Edit();
+		vector<int64_t>& newLargeCounts = merged.largeCounts.Edit();
+		newStarts.resize(words.Size() + 1);
+		newSeconds.reserve(seconds.size() + staged.size());
+		newCounts.reserve(seconds.size() + staged.size());
+		// merge the existing range and the staged bigrams of every first word id
+		size_t s = 0;
+		for (uint32_t first = 0; first < words.Size(); first++)
+		{
+			newStarts[first] = (uint32_t)newSeconds.size();
+			const uint32_t* end;
+			const uint32_t* existing = Range(first, end);
+			for (;;)
+			{
+				bool stagedNext = s < staged.size() && staged[s].first == first;
+				if (existing != end && (!stagedNext || *existing <= staged[s].second))
+				{
+					if (stagedNext && *existing == staged[s].second) s++;
+					newSeconds.push_back(*existing);
+					newCounts.push_back(Encode(Decode(counts[existing - seconds.data()]), newLargeCounts));
+					existing++;
+				}
+				else if (stagedNext)
+				{
+					newSeconds.push_back(staged[s].second);
+					newCounts.push_back(Encode(staged[s].count, newLargeCounts));
+					s++;
+				}
+				else break;
+			}
+		}
+		newStarts[words.Size()] = (uint32_t)newSeconds.size();
+		merged.words = std::move(words);
+		*this = std::move(merged);
+	}
+
+	/// <summary>Write the table to, or attach it to, a snapshot.</summary>
+	/// <remarks>The archive provides Array(FlatArray&lt;T&gt;&amp;) and Value(T&amp;).</remarks>
+	template <class Archive>
+	void Serialize(Archive& archive)
+	{
+		words.Serialize(archive);
+		archive.Array(starts);
+		archive.Array(seconds);
+		archive.Array(counts);
+		archive.Array(largeCounts);
+	}
+
+	/// <summary>Check that the arrays of the table, e.g. attached to a snapshot, are consistent, so that no lookup reads out of bounds.</summary>
+	bool Validate() const
+	{
+		if (!words.Validate() || starts.empty() || starts.size() > words.Size() + 1 || starts[0] != 0
+			|| starts[starts.size() - 1] != seconds.size() || counts.size() != seconds.size()) return false;
+		for (size_t first = 0; first + 1 < starts.size(); first++)
+		{
+			if (starts[first] > starts[first + 1]) return false;
+			for (uint32_t i = starts[first]; i < starts[first + 1]; i++)
+			{
+				// ascending within a range, for the binary search
+				if (seconds[i] >= words.Size() || (i > starts[first] && seconds[i - 1] >= seconds[i])) return false;
+			}
+		}
+		for (uint32_t count : counts)
+		{
+			if ((count & LargeCount) && count - LargeCount >= largeCounts.size()) return false;
+		}
+		return true;
+	}
+};
+
+class Node
+{
+public:
+	uint32_t suggestion; // word id
+	int next;
+};
+
+class Entry
+{
+public:
+	int count;
+	int first;
+};
+
+/// <summary>Mapping of delete hashes to the ids of the dictionary words they were derived from.</summary>
+/// <remarks>The index is an open addressing hash table of delete hashes, where every slot
+/// refers to a contiguous range (bucket) of one shared array of word ids. Lookups probe
+/// a flat array and then walk contiguous memory, instead of chasing map nodes, vectors
+/// and string copies. Additions are merged in bulk by rebuilding the arrays, see SuggestionStage,
+/// or added and removed one at a time in place with Add and Remove.</remarks>
+class DeleteIndex
+{
+private:
+	struct Slot
+	{
+		int hash;
+		uint32_t first; // position of the bucket in ids
+		uint32_t count; // bucket size, 0 = empty slot
+	};
+
+	// an entry of ids that belongs to no bucket, left by a removal or a moved bucket
+	static constexpr uint32_t Vacant = 0xFFFFFFFFu;
+
+	FlatArray<Slot> slots;
+	FlatArray<uint32_t> ids;
+	uint32_t mask = 0;
+	int shift = 32;
+	uint64_t used = 0;
+	uint64_t vacant = 0;
+	// every bucket is ordered by descending word count, ties in the order the ids were added
+	bool sorted = true;
+
+	// multiplicative hashing, as the low bits of a delete hash only encode its length
+	static uint32_t Index(int deleteHash, int shift) { return (uint32_t)(((uint64_t)(uint32_t)deleteHash * 2654435769u) & 0xFFFFFFFF) >> shift; }
+
+	// Robin Hood insertion, with ties of the probe distance broken by hash, so that the slot
+	// layout only depends on the set of hashes and not on the order they are inserted in.
+	// Adds the count of carried to the slot of its hash, and returns true if the hash was new.
+	bool Insert(Slot carried)
+	{
+		vector<Slot>& table = slots.Edit();
+		uint32_t distance = 0;
+		for (uint32_t i = Index(carried.hash, shift); ; i = (i + 1) & mask, distance++)
+		{
+			if (table[i].count == 0)
+			{
+				table[i] = carried;
+				return true;
+			}
+			if (table[i].hash == carried.hash)
+			{
+				table[i].count += carried.count;
+				return false;
+			}
+			uint32_t slotDistance = (i - Index(table[i].hash, shift)) & mask;
+			if (slotDistance < distance || (slotDistance == distance && table[i].hash > carried.hash))
+			{
+				swap(table[i], carried);
+				distance = slotDistance;
+			}
+		}
+	}
+
+	Slot* Locate(int deleteHash)
+	{
+		vector<Slot>& table = slots.Edit();
+		uint32_t i = Index(deleteHash, shift);
+		while (table[i].hash != deleteHash || table[i].count == 0) i = (i + 1) & mask;
+		return &table[i];
+	}
+
+	void Resize(uint32_t capacity)
+	{
+		mask = capacity - 1;
+		shift = 32;
+		while (capacity > 1) { capacity >>= 1; shift--; }
+	}
+
+	// double the number of slots, keeping the buckets in place
+	void Grow()
+	{
+		vector<Slot> old(slots.begin(), slots.end());
+		uint32_t capacity = old.empty() ? 16 : (uint32_t)old.size() * 2;
+		Resize(capacity);
+		slots.Edit().assign(capacity, Slot{ 0, 0, 0 });
+		for (const Slot& slot : old)
+		{
+			if (slot.count != 0) Insert(slot);
+		}
+	}
+
+	// the slot of a delete hash for modification, or null if the hash is unknown
+	Slot* FindSlot(int deleteHash)
+	{
+		if (used == 0) return nullptr;
+		vector<Slot>& table = slots.Edit();
+		uint32_t distance = 0;
+		for (uint32_t i = Index(deleteHash, shift); table[i].count != 0; i = (i + 1) & mask, distance++)
+		{
+			if (table[i].hash == deleteHash) return &table[i];
+			if (((i - Index(table[i].hash, shift)) & mask) < distance) break;
+		}
+		return nullptr;
+	}
+
+	// Robin Hood backward shift deletion: move the following slots of the probe sequence one back,
+	// until a slot is empty or at its home position
+	void EraseSlot(Slot* slot)
+	{
+		vector<Slot>& table = slots.Edit();
+		uint32_t i = (uint32_t)(slot - table.data());
+		for (;;)
+		{
+			uint32_t next = (i + 1) & mask;
+			if (table[next].count == 0 || ((next - Index(table[next].hash, shift)) & mask) == 0) break;
+			table[i] = table[next];
+			i = next;
+		}
+		table[i] = Slot{ 0, 0, 0 };
+	}
+
+public:
+	/// <summary>A non-owning view of the word ids stored for one delete hash.</summary>
+	struct Bucket
+	{
+		const uint32_t* first = nullptr;
+		const uint32_t* last = nullptr;
+		const uint32_t* begin() const { return first; }
+		const uint32_t* end() const { return last; }
+		size_t size() const { return last - first; }
+		bool empty() const { return first == last; }
+	};
+
+	/// <summary>Number of distinct delete hashes in the index.</summary>
+	size_t Size() const { return used; }
+
+	/// <summary>Total number of word ids stored in all buckets.</summary>
+	size_t IdCount() const { return ids.size() - (size_t)vacant; }
+
+	/// <summary>Number of word ids in the largest bucket.</summary>
+	uint32_t MaxBucketSize() const
+	{
+		uint32_t size = 0;
+		for (const Slot& slot : slots) size = max(size, slot.count);
+		return size;
+	}
+
+	/// <summary>Bytes of the owned hash slots.</summary>
+	size_t SlotBytes() const { return slots.HeapBytes(); }
+
+	/// <summary>Bytes of the owned word ids of the buckets.</summary>
+	size_t IdBytes() const { return ids.HeapBytes(); }
+
+	/// <summary>Bytes referenced in a snapshot.</summary>
+	size_t MappedBytes() const { return slots.MappedBytes() + ids.MappedBytes(); }
+
+	/// <summary>Find the bucket of word ids for a delete hash.</summary>
+	/// <returns>The bucket, which is empty if the delete hash is unknown.</returns>
+	Bucket Find(int deleteHash) const
+	{
+		Bucket bucket;
+		if (used == 0) return bucket;
+		const Slot* table = slots.data();
+		uint32_t distance = 0;
+		for (uint32_t i = Index(deleteHash, shift); table[i].count != 0; i = (i + 1) & mask, distance++)
+		{
+			if (table[i].hash == deleteHash)
+			{
+				bucket.first = ids.data() + table[i].first;
+				bucket.last = bucket.first + table[i].count;
+				break;
+			}
+			// Robin Hood invariant: the hash would have displaced any entry closer to its home slot
+			if (((i - Index(table[i].hash, shift)) & mask) < distance) break;
+		}
+		return bucket;
+	}
+
+	/// <summary>True if every bucket is ordered by descending word count, so that the first id of a bucket
+	/// has its largest count and no id is followed by one with a larger count.</summary>
+	bool Sorted() const { return sorted; }
+
+	/// <summary>Note that counts of words in the index changed in bulk, which may break the order of their buckets
+	/// until the next Sort. A single change keeps the order with Reposition.</summary>
+	void CountChanged() { sorted = false; }
+
+	/// <summary>Order every bucket by descending word count, keeping the order of equal counts.</summary>
+	/// <param name="words">The words of the ids, with their counts.</param>
+	void Sort(const WordTable& words)
+	{
+		if (sorted) return;
+		vector<uint32_t>& list = ids.Edit();
+		vector<pair<int64_t, uint32_t>> bucket;
+		for (const Slot& slot : slots)
+		{
+			if (slot.count < 2) continue;
+			uint32_t* first = list.data() + slot.first;
+			bucket.clear();
+			for (uint32_t i = 0; i < slot.count; i++) bucket.push_back(pair<int64_t, uint32_t>(words.Count(first[i]), first[i]));
+			// most buckets are small, for which an insertion sort beats the buffer of a stable sort
+			if (slot.count <= 16)
+			{
+				for (size_t i = 1; i < bucket.size(); i++)
+				{
+					pair<int64_t, uint32_t> entry = bucket[i];
+					size_t j = i;
+					for (; j > 0 && bucket[j - 1].first < entry.first; j--) bucket[j] = bucket[j - 1];
+					bucket[j] = entry;
+				}
+			}
+			else std::stable_sort(bucket.begin(), bucket.end(), [](const pair<int64_t, uint32_t>& l, const pair<int64_t, uint32_t>& r) { return l.first > r.first; });
+			for (uint32_t i = 0; i < slot.count; i++) first[i] = bucket[i].second;
+		}
+		sorted = true;
+	}
+
+	/// <summary>Add a word id to the bucket of a delete hash, in place.</summary>
+	/// <remarks>A bucket grows into the vacant ids that follow it, or else is moved to the end of the ids
+	/// with room to double, leaving its old place vacant. The ids are compacted once more than half of them
+	/// are vacant, so that an addition takes amortized constant time, plus the bucket size if it is moved.
+	/// In a sorted index the id is moved before the ids with smaller counts, which takes up to the bucket size.</remarks>
+	/// <param name="words">The words of the ids, with their counts.</param>
+	void Add(int deleteHash, uint32_t id, const WordTable& words)
+	{
+		vector<uint32_t>& list = ids.Edit();
+		Slot* slot = FindSlot(deleteHash);
+		if (slot == nullptr)
+		{
+			if ((used + 1) * 2 > slots.size()) Grow();
+			Insert(Slot{ deleteHash, (uint32_t)list.size(), 1 });
+			used++;
+			list.push_back(id);
+			return;
+		}
+		uint32_t end = slot->first + slot->count;
+		if (end == list.size()) list.push_back(id);
+		else if (list[end] == Vacant)
+		{
+			list[end] = id;
+			vacant--;
+		}
+		else
+		{
+			uint32_t capacity = 2;
+			while (capacity < slot->count + 1) capacity <<= 1;
+			uint32_t first = (uint32_t)list.size();
+			list.resize(first + capacity, Vacant);
+			std::copy(list.begin() + slot->first, list.begin() + end, list.begin() + first);
+			std::fill(list.begin() + slot->first, list.begin() + end, Vacant);
+			list[first + slot->count] = id;
+			vacant += capacity - 1;
+			slot->first = first;
+		}
+		slot->count++;
+		if (sorted)
+		{
+			int64_t count = words.Count(id);
+			uint32_t* first = list.data() + slot->first;
+			uint32_t i = slot->count - 1;
+			for (; i > 0 && words.Count(first[i - 1]) < count; i--) first[i] = first[i - 1];
+			first[i] = id;
+		}
+		if (vacant * 2 > list.size()) Compact();
+	}
+
+	/// <summary>Move a word id within the bucket of a delete hash to the position of its changed count, in place.</summary>
+	/// <remarks>Only in a sorted index, which stays sorted: the id is moved after the ids with an equal count, as
+	/// with Add, which takes up to the bucket size.</remarks>
+	/// <param name="words">The words of the ids, with their counts.</param>
+	void Reposition(int deleteHash, uint32_t id, const WordTable& words)
+	{
+		if (!sorted) return;
+		Slot* slot = FindSlot(deleteHash);
+		if (slot == nullptr) return;
+		uint32_t* first = ids.Edit().data() + slot->first;
+		uint32_t* last = first + slot->count;
+		uint32_t* found = std::find(first, last, id);
+		if (found == last) return;
+		int64_t count = words.Count(id);
+		// a larger count moves the id toward the front past smaller counts, a smaller one toward the back past larger or equal ones
+		for (; found != first && words.Count(found[-1]) < count; found--) *found = found[-1];
+		for (; found + 1 != last && words.Count(found[1]) >= count; found++) *found = found[1];
+		*found = id;
+	}
+
+	/// <summary>Remove a word id from the bucket of a delete hash, in place, keeping the order of the others.</summary>
+	/// <returns>True if the id was in the bucket.</returns>
+	bool Remove(int deleteHash, uint32_t id)
+	{
+		Slot* slot = FindSlot(deleteHash);
+		if (slot == nullptr) return false;
+		vector<uint32_t>& list = ids.Edit();
+		uint32_t* first = list.data() + slot->first;
+		uint32_t* last = first + slot->count;
+		uint32_t* found = std::find(first, last, id);
+		if (found == last) return false;
+		std::copy(found + 1, last, found);
+		last[-1] = Vacant;
+		vacant++;
+		if (--slot->count == 0)
+		{
+			EraseSlot(slot);
+			used--;
+		}
+		return true;
+	}
+
+	/// <summary>Replace every word id by its new id, after WordTable::Compact or WordTable::Freeze. The order of the buckets is kept.</summary>
+	/// <param name="renumbered">The new id of every old id.</param>
+	void Renumber(const vector<uint32_t>& renumbered)
+	{
+		vector<uint32_t>& list = ids.Edit();
+		for (const Slot& slot : slots)
+		{
+			for (uint32_t i = slot.first; i < slot.first + slot.count; i++) list[i] = renumbered[list[i]];
+		}
+	}
+
+	/// <summary>Lay the buckets out back to back again, without vacant ids.</summary>
+	void Compact()
+	{
+		vector<uint32_t> compacted;
+		compacted.reserve(ids.size() - (size_t)vacant);
+		for (Slot& slot : slots.Edit())
+		{
+			if (slot.count == 0) continue;
+			uint32_t first = (uint32_t)compacted.size();
+			compacted.insert(compacted.end(), ids.begin() + slot.first, ids.begin() + slot.first + slot.count);
+			slot.first = first;
+		}
+		ids.Edit().swap(compacted);
+		vacant = 0;
+	}
+
+	/// <summary>Rebuild the index with staged suggestions appended to their buckets, which leaves it unsorted.</summary>
+	/// <remarks>Existing buckets keep their order, staged suggestions of a delete are
+	/// appended in the order of the staged linked list (most recently staged first).</remarks>
+	/// <param name="staged">Staged deletes, mapping delete hashes to linked lists of nodes.</param>
+	/// <param name="nodes">The nodes of the staged linked lists.</param>
+	void Merge(MeasuredDictionary<int, Entry>& staged, ChunkArray<Node>& nodes)
+	{
+		Merge(staged.size(),
+			[&](auto size)
+			{
+				for (auto it = staged.begin(); it != staged.end(); ++it) size(it->first, it->second.count);
+			},
+			[&](auto bucket)
+			{
+				for (auto it = staged.begin(); it != staged.end(); ++it)
+				{
+					uint32_t* position = bucket(it->first, it->second.count);
+					for (int next = it->second.first; next >= 0; next = nodes.At(next).next)
+						*position++ = nodes.At(next).suggestion;
+				}
+			});
+	}
+
+	/// <summary>Rebuild the index with presorted staged suggestions appended to their buckets, which leaves it unsorted.</summary>
+	/// <remarks>Existing buckets keep their order. Within a shard, the suggestions of a delete
+	/// must be adjacent and are appended in the order they appear in. A delete hash must only
+	/// appear in one shard.</remarks>
+	/// <param name="shards">Staged (delete hash, word id) pairs, grouped by delete hash.</param>
+	void Merge(const vector<vector<pair<int, uint32_t>>>& shards)
+	{
+		// visit every run of equal delete hashes in every shard
+		auto runs = [&](auto visit)
+		{
+			for (const vector<pair<int, uint32_t>>& shard : shards)
+			{
+				for (size_t first = 0, last = 0; first < shard.size(); first = last)
+				{
+					while (last < shard.size() && shard[last].first == shard[first].first) last++;
+					visit(shard[first].first, (uint32_t)(last - first), &shard[first]);
+				}
+			}
+		};
+		size_t stagedHashes = 0;
+		runs([&](int, uint32_t, const pair<int, uint32_t>*) { stagedHashes++; });
+		Merge(stagedHashes,
+			[&](auto size)
+			{
+				runs([&](int hash, uint32_t count, const pair<int, uint32_t>*) { size(hash, count); });
+			},
+			[&](auto bucket)
+			{
+				runs([&](int hash, uint32_t count, const pair<int, uint32_t>* run)
+				{
+					uint32_t* position = bucket(hash, count);
+					for (uint32_t i = 0; i < count; i++) position[i] = run[i].second;
+				});
+			});
+	}
+
+private:
+	// Rebuild the index with staged buckets appended. forEachSize(size) must call size(hash, count)
+	// once per staged delete hash, forEachBucket(bucket) must write count ids to bucket(hash, count)
+	// for the same hashes and counts.
+	template <class ForEachSize, class ForEachBucket>
+	void Merge(size_t stagedHashes, ForEachSize forEachSize, ForEachBucket forEachBucket)
+	{
+		if (stagedHashes == 0) return;
+		uint32_t capacity = 16;
+		while (capacity < (used + stagedHashes) * 2) capacity <<= 1;
+		DeleteIndex merged;
+		merged.Resize(capacity);
+		merged.slots.Edit().assign(capacity, Slot{ 0, 0, 0 });
+
+		// size the buckets of the union of existing and staged delete hashes
+		auto size = [&](int hash, uint32_t count)
+		{
+			merged.used += merged.Insert(Slot{ hash, 0, count });
+		};
+		for (const Slot& slot : slots)
+		{
+			if (slot.count != 0) size(slot.hash, slot.count);
+		}
+		forEachSize(size);
+
+		// lay the buckets out back to back
+		vector<Slot>& newSlots = merged.slots.Edit();
+		uint32_t total = 0;
+		for (Slot& slot : newSlots)
+		{
+			slot.first = total;
+			total += slot.count;
+		}
+
+		// fill the buckets, existing suggestions first
+		vector<uint32_t>& newIds = merged.ids.Edit();
+		newIds.resize(total);
+		vector<uint32_t> fill(capacity, 0);
+		auto bucket = [&](int hash, uint32_t count)
+		{
+			Slot* target = merged.Locate(hash);
+			uint32_t& position = fill[target - newSlots.data()];
+			uint32_t* first = newIds.data() + target->first + position;
+			position += count;
+			return first;
+		};
+		for (const Slot& slot : slots)
+		{
+			if (slot.count != 0) std::copy(ids.begin() + slot.first, ids.begin() + slot.first + slot.count, bucket(slot.hash, slot.count));
+		}
+		forEachBucket(bucket);
+
+		// staged suggestions are appended whatever their count, until the owner sorts the index again
+		merged.sorted = false;
+		*this = std::move(merged);
+	}
+
+public:
+	/// <summary>Write the index to, or attach it to, a snapshot.</summary>
+	/// <remarks>The archive provides Array(FlatArray&lt;T&gt;&amp;) and Value(T&amp;).</remarks>
+	template <class Archive>
+	void Serialize(Archive& archive)
+	{
+		// a snapshot holds no vacant ids, so that an attached index needs no count of them
+		if (vacant != 0) Compact();
+		archive.Value(used);
+		archive.Value(sorted);
+		archive.Array(slots);
+		archive.Array(ids);
+		Resize(slots.empty() ? 1 : (uint32_t)slots.size());
+	}
+
+	/// <summary>Check that the arrays of the index, e.g. attached to a snapshot, are consistent, so that no
+	/// lookup reads out of bounds, that every bucket is found by its hash and holds ids of words, and that
+	/// a sorted index is sorted.</summary>
+	/// <param name="words">The words of the ids, with their counts.</param>
+	bool Validate(const WordTable& words) const
+	{
+		if (slots.empty()) return used == 0 && ids.size() == vacant;
+		// a power of two, with an empty slot that ends every probe sequence
+		if ((slots.size() & (slots.size() - 1)) != 0 || (slots.size() >> 32) != 0) return false;
+		uint64_t occupied = 0, total = 0;
+		for (const Slot& slot : slots)
+		{
+			if (slot.count == 0) continue;
+			if ((uint64_t)slot.first + slot.count > ids.size()) return false;
+			occupied++;
+			total += slot.count;
+		}
+		if (occupied != used || used >= slots.size() || total + vacant != ids.size()) return false;
+		for (const Slot& slot : slots)
+		{
+			if (slot.count == 0) continue;
+			if (Find(slot.hash).first != ids.data() + slot.first) return false;
+			const uint32_t* bucket = ids.data() + slot.first;
+			for (uint32_t i = 0; i < slot.count; i++)
+			{
+				if (bucket[i] >= words.Size()) return false;
+				if (sorted && i > 0 && words.Count(bucket[i - 1]) < words.Count(bucket[i])) return false;
+			}
+		}
+		return true;
+	}
+};
+
+/// <summary>An intentionally opacque class used to temporarily stage
+/// dictionary data during the adding of many words. By staging the
+/// data during the building of the dictionary data, significant savings
+/// of time can be achieved, as well as a reduction in final memory usage.</summary>
+class SuggestionStage
+{
+private:
+	MeasuredDictionary<int, Entry> Deletes;
+	ChunkArray<Node> Nodes;
+
+public:
+	/// <summary>Create a new instance of SuggestionStage.</summary>
+	/// <remarks>Specifying ann accurate initialCapacity is not essential, 
+	/// but it can help speed up processing by alleviating the need for 
+	/// data restructuring as the size grows.</remarks>
+	/// <param name="initialCapacity">The expected number of words that will be added.</param>
+	SuggestionStage(int initialCapacity)
+	{
+		Deletes.reserve(initialCapacity);
+		Nodes.Reserve(initialCapacity * 2);
 	}
 
 	/// <summary>Gets the count of unique delete words.</summary>
@@ -844,6 +2905,9 @@ public:
 	/// <summary>Gets the total count of all suggestions for all deletes.</summary>
 	int NodeCount() { return Nodes.Count; }
 
+	/// <summary>Gets the bytes of the staged deletes and suggestions.</summary>
+	size_t HeapBytes() const { return MapBytes(Deletes) + Nodes.HeapBytes(); }
+
 	/// <summary>Clears all the data from the SuggestionStaging.</summary>
 	void Clear()
 	{
@@ -851,7 +2915,9 @@ public:
 		Nodes.Clear();
 	}
 
-	void Add(int deleteHash, xstring suggestion)
+	/// <param name="deleteHash">Hash of the delete.</param>
+	/// <param name="suggestion">Id of the dictionary word the delete was derived from.</param>
+	void Add(int deleteHash, uint32_t suggestion)
 	{
 		auto deletesFinded = Deletes.find(deleteHash);
 		Entry newEntry;
@@ -868,42 +2934,9 @@ public:
 		Nodes.Add(item);
 	}
 
-	void CommitTo(Dictionary<int, vector<xstring>>* permanentDeletes)
+	void CommitTo(DeleteIndex* permanentDeletes)
 	{
-		auto permanentDeletesEnd = permanentDeletes->end();
-		for (auto it = Deletes.begin(); it != Deletes.end(); ++it)
-		{
-			auto permanentDeletesFinded = permanentDeletes->find(it->first);
-			vector<xstring> suggestions;
-			int i;
-			if (permanentDeletesFinded != permanentDeletesEnd)
-			{
-				suggestions = permanentDeletesFinded->second;
-				i = suggestions.size();
-
-				vector<xstring> newSuggestions;
-				newSuggestions.reserve(suggestions.size() + it->second.count);
-				std::copy(suggestions.begin(), suggestions.end(), back_inserter(newSuggestions));
-				//permanentDeletes[it->first] = newSuggestions;
-			}
-			else
-			{
-				i = 0;
-				int32_t count = it->second.count;
-				suggestions.reserve(count);
-				//permanentDeletes[it->first] = suggestions;
-			}
-
-			int next = it->second.first;
-			while (next >= 0)
-			{
-				auto node = Nodes.At(next);
-				suggestions.push_back(node.suggestion);
-				next = node.next;
-				++i;
-			}
-			(*permanentDeletes)[it->first] = suggestions;
-		}
+		permanentDeletes->Merge(Deletes, Nodes);
 	}
 };
 
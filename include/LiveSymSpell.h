@@ -0,0 +1,272 @@
+#pragma once
+#include "SymSpell.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+/// <summary>Outcome of LiveSymSpell::ApplyDelta.</summary>
+struct DeltaReload
+{
+	/// <summary>False if the delta file was not found, and no generation was published.</summary>
+	bool loaded = false;
+	/// <summary>Number of words added, updated and removed.</summary>
+	DeltaStats changes;
+	/// <summary>Lines of the delta file that could not be parsed, and were skipped.</summary>
+	vector<LoadError> errors;
+	/// <summary>Seconds taken to copy the current generation.</summary>
+	double copySeconds = 0;
+	/// <summary>Seconds taken to apply the delta to the copy.</summary>
+	double applySeconds = 0;
+	/// <summary>Seconds taken to publish the copy as the current generation, and free unused generations.</summary>
+	double swapSeconds = 0;
+};
+
+/// <summary>A SymSpell that is updated while other threads query it, without locking the queries.</summary>
+/// <remarks>The dictionary is kept as a sequence of immutable generations. Readers pin the current generation
+/// for the duration of their queries, which takes two atomic stores and a load. A writer copies the current
+/// generation, changes the copy, and publishes it as the next generation; the queries of pinned readers go on
+/// with the generation they started with. A replaced generation is freed once no reader that may have pinned
+/// it is still reading (epoch based reclamation), so it is never freed under a reader, and readers never wait
+/// for writers. An update costs a copy of the dictionary, so many changes should be made in one Update.
+/// The read state of a thread is freed when the thread exits and reused by later threads, so the writer's
+/// scan of the readers is bounded by the number of threads that run at the same time.
+/// All generations share the cache and statistics sink of the first one.</remarks>
+class LiveSymSpell
+{
+private:
+	// the read state of a thread, for this LiveSymSpell
+	struct alignas(64) Reader
+	{
+		// false once the thread exited, so that another thread can take the slot
+		bool used = true;
+		// the global epoch at the time the thread started reading, 0 = not reading
+		atomic<uint64_t> epoch{ 0 };
+		// number of nested pins, only used by the reading thread
+		int depth = 0;
+	};
+
+	// the read states, shared with the threads that read, which free their slot when they exit,
+	// even if that is after the LiveSymSpell was destroyed
+	struct Readers
+	{
+		mutex lock;
+		deque<Reader> slots;
+	};
+
+	// instances are told apart by id rather than address, which may be reused by a later instance
+	uint64_t id;
+	atomic<const SymSpell*> current;
+	// incremented after every publication of a generation
+	atomic<uint64_t> epoch{ 1 };
+	shared_ptr<Readers> readers;
+	// serializes writers, and guards retired
+	mutex writer;
+	// replaced generations, with the epoch from which on no reader can pin them
+	vector<pair<uint64_t, unique_ptr<const SymSpell>>> retired;
+
+	static uint64_t NextId()
+	{
+		static atomic<uint64_t> ids(1);
+		return ids.fetch_add(1, memory_order_relaxed);
+	}
+
+	// the read state of the calling thread, cached for the instance it last read
+	Reader& Local() const
+	{
+		// the slots of a thread in all instances it read, which are freed when the thread exits
+		struct Owner
+		{
+			struct Slot
+			{
+				uint64_t instance;
+				weak_ptr<Readers> readers;
+				Reader* reader;
+			};
+			vector<Slot> slots;
+			uint64_t instance = 0;
+			Reader* reader = nullptr;
+
+			~Owner()
+			{
+				for (Slot& slot : slots)
+				{
+					shared_ptr<Readers> owner = slot.readers.lock();
+					if (!owner) continue;
+					lock_guard<mutex> guard(owner->lock);
+					slot.reader->epoch.store(0);
+					slot.reader->depth = 0;
+					slot.reader->used = false;
+				}
+			}
+		};
+		static thread_local Owner owner;
+		if (owner.instance != id)
+		{
+			Reader* found = nullptr;
+			for (const Owner::Slot& slot : owner.slots)
+			{
+				if (slot.instance == id) found = slot.reader;
+			}
+			if (found == nullptr)
+			{
+				// forget the slots of destroyed instances
+				owner.slots.erase(remove_if(owner.slots.begin(), owner.slots.end(),
+					[](const Owner::Slot& slot) { return slot.readers.expired(); }), owner.slots.end());
+				lock_guard<mutex> guard(readers->lock);
+				for (Reader& reader : readers->slots)
+				{
+					if (!reader.used && found == nullptr) found = &reader;
+				}
+				if (found == nullptr)
+				{
+					readers->slots.emplace_back();
+					found = &readers->slots.back();
+				}
+				found->used = true;
+				owner.slots.push_back({ id, readers, found });
+			}
+			owner.instance = id;
+			owner.reader = found;
+		}
+		return *owner.reader;
+	}
+
+	// publish the next generation, with the writer lock held
+	void Publish(unique_ptr<SymSpell> next)
+	{
+		const SymSpell* replaced = current.exchange(next.release());
+		// readers that start from now on see the next generation, older readers may still read the replaced one
+		uint64_t stamp = epoch.fetch_add(1) + 1;
+		retired.emplace_back(stamp, unique_ptr<const SymSpell>(replaced));
+		ReclaimRetired();
+	}
+
+	// free the retired generations that started being retired before every current reader started
+	void ReclaimRetired()
+	{
+		uint64_t oldest = UINT64_MAX;
+		{
+			lock_guard<mutex> guard(readers->lock);
+			for (Reader& reader : readers->slots)
+			{
+				uint64_t started = reader.epoch.load();
+				if (started != 0 && started < oldest) oldest = started;
+			}
+		}
+		size_t kept = 0;
+		for (size_t i = 0; i < retired.size(); i++)
+		{
+			if (retired[i].first > oldest) retired[kept++] = move(retired[i]);
+		}
+		retired.resize(kept);
+	}
+
+public:
+	/// <summary>A pinned generation, which stays valid until the pin is destroyed.</summary>
+	/// <remarks>A pin must be destroyed by the thread that created it. Pins of a thread may be nested.</remarks>
+	class Pin
+	{
+	private:
+		Reader& reader;
+		const SymSpell* symSpell;
+
+	public:
+		Pin(Reader& reader, const SymSpell* symSpell) : reader(reader), symSpell(symSpell) {}
+		Pin(const Pin&) = delete;
+		Pin& operator=(const Pin&) = delete;
+
+		~Pin()
+		{
+			if (--reader.depth == 0) reader.epoch.store(0, memory_order_release);
+		}
+
+		const SymSpell& operator*() const { return *symSpell; }
+		const SymSpell* operator->() const { return symSpell; }
+	};
+
+	/// <summary>Create a live dictionary.</summary>
+	/// <param name="initial">The first generation.</param>
+	explicit LiveSymSpell(unique_ptr<SymSpell> initial) : id(NextId()), current(initial.release()), readers(make_shared<Readers>())
+	{
+		if (current.load() == nullptr) throw std::invalid_argument("initial");
+	}
+
+	LiveSymSpell(const LiveSymSpell&) = delete;
+	LiveSymSpell& operator=(const LiveSymSpell&) = delete;
+
+	/// <summary>Destroy all generations. No thread may still hold a pin.</summary>
+	~LiveSymSpell()
+	{
+		delete current.load();
+	}
+
+	/// <summary>Pin the current generation, to query it.</summary>
+	/// <remarks>Updates published while the pin is held are not seen through it. Holding a pin for long keeps
+	/// the generations replaced in the meantime in memory.</remarks>
+	Pin Read() const
+	{
+		Reader& reader = Local();
+		// the epoch is published before the generation is loaded (both sequentially consistent), so that a writer
+		// that retires the loaded generation afterwards sees the epoch of the reader
+		if (reader.depth++ == 0) reader.epoch.store(epoch.load());
+		return Pin(reader, current.load());
+	}
+
+	/// <summary>Change the dictionary, and publish the result as the next generation.</summary>
+	/// <remarks>Writers are serialized. The change is made to a copy of the current generation, which is
+	/// discarded if the change throws.</remarks>
+	/// <param name="change">The change, e.g. calls of CreateDictionaryEntry or RemoveDictionaryEntry.</param>
+	void Update(const function<void(SymSpell&)>& change)
+	{
+		lock_guard<mutex> guard(writer);
+		unique_ptr<SymSpell> next(new SymSpell(*current.load()));
+		change(*next);
+		Publish(move(next));
+	}
+
+	/// <summary>Apply a file of dictionary changes, and publish the result as the next generation.</summary>
+	/// <remarks>See SymSpell::ApplyDelta for the format. Only the changed words are updated, so the cost is
+	/// a copy of the dictionary plus the changes, instead of loading the whole dictionary.</remarks>
+	/// <param name="delta">The path+filename of the file.</param>
+	/// <param name="separatorChars">Separator characters between operation, word and count.</param>
+	/// <returns>The changes, parse errors and durations of the reload.</returns>
+	DeltaReload ApplyDelta(string delta, xchar separatorChars = DEFAULT_SEPARATOR_CHAR)
+	{
+		DeltaReload reload;
+		lock_guard<mutex> guard(writer);
+		auto start = chrono::steady_clock::now();
+		unique_ptr<SymSpell> next(new SymSpell(*current.load()));
+		auto copied = chrono::steady_clock::now();
+		reload.loaded = next->ApplyDelta(delta, &reload.changes, separatorChars);
+		reload.errors = next->LoadErrors();
+		auto applied = chrono::steady_clock::now();
+		if (reload.loaded) Publish(move(next));
+		reload.copySeconds = chrono::duration<double>(copied - start).count();
+		reload.applySeconds = chrono::duration<double>(applied - copied).count();
+		reload.swapSeconds = chrono::duration<double>(chrono::steady_clock::now() - applied).count();
+		return reload;
+	}
+
+	/// <summary>Number of read states, one per thread that read and is still running, plus free ones
+	/// of exited threads that the next new reading threads reuse.</summary>
+	size_t ReaderSlots() const
+	{
+		lock_guard<mutex> guard(readers->lock);
+		return readers->slots.size();
+	}
+
+	/// <summary>Free the replaced generations that no reader uses anymore. Update does this as well.</summary>
+	/// <returns>The number of replaced generations that are still in use.</returns>
+	size_t Reclaim()
+	{
+		lock_guard<mutex> guard(writer);
+		ReclaimRetired();
+		return retired.size();
+	}
+};
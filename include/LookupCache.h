@@ -0,0 +1,249 @@
+#pragma once
+#include "Helpers.h"
+#include <mutex>
+
+using namespace std;
+
+/// <summary>The operation and arguments a cached result was computed for.</summary>
+struct LookupCacheKey
+{
+	/// <summary>The operations whose results are cached.</summary>
+	enum Operation
+	{
+		Lookup,
+		LookupCompound
+	};
+
+	Operation operation;
+	xstring_view input;
+	int verbosity;
+	int maxEditDistance;
+	bool includeUnknown;
+};
+
+/// <summary>Counters of a LookupCache.</summary>
+struct LookupCacheStats
+{
+	/// <summary>Number of results found in the cache.</summary>
+	uint64_t hits = 0;
+	/// <summary>Number of results not found in the cache, or computed for an older dictionary.</summary>
+	uint64_t misses = 0;
+	/// <summary>Number of results removed to stay within the byte budget.</summary>
+	uint64_t evictions = 0;
+	/// <summary>Number of results in the cache.</summary>
+	size_t entries = 0;
+	/// <summary>Estimated memory use of the results in the cache.</summary>
+	size_t bytes = 0;
+};
+
+/// <summary>A bounded, thread-safe cache of Lookup and LookupCompound results, including empty results.</summary>
+/// <remarks>Results are stored with the generation of the dictionary they were computed for, and a result
+/// of an older generation is a miss, so that a dictionary update invalidates all earlier results. The
+/// cache is split into shards with a lock each, by hash of the key. Each shard holds at most its share of the
+/// byte budget, and evicts results that were not used since the clock hand last passed them (CLOCK).
+/// A cache must only be attached to one SymSpell.</remarks>
+class LookupCache
+{
+private:
+	struct Entry
+	{
+		uint64_t hash = 0;
+		uint64_t generation = 0;
+		LookupCacheKey::Operation operation = LookupCacheKey::Lookup;
+		int verbosity = 0;
+		int maxEditDistance = 0;
+		bool includeUnknown = false;
+		bool used = false;
+		bool referenced = false;
+		size_t bytes = 0;
+		xstring input;
+		vector<SuggestItem> result;
+	};
+
+	struct alignas(64) Shard
+	{
+		mutex lock;
+		vector<Entry> entries;
+		vector<uint32_t> unused;
+		Dictionary<uint64_t, uint32_t> index;
+		size_t hand = 0;
+		size_t bytes = 0;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+	};
+
+	size_t shardBudget;
+	int shardShift;
+	vector<Shard> shards;
+
+	static uint64_t Hash(const LookupCacheKey& key)
+	{
+		uint64_t hash = PrefixHashes::Of(key.input);
+		hash = (hash ^ (uint64_t)key.operation) * 0x9E3779B97F4A7C15ULL;
+		hash = (hash ^ (uint64_t)key.verbosity) * 0x9E3779B97F4A7C15ULL;
+		hash = (hash ^ (uint64_t)key.maxEditDistance) * 0x9E3779B97F4A7C15ULL;
+		hash = (hash ^ (uint64_t)key.includeUnknown) * 0x9E3779B97F4A7C15ULL;
+		return hash ^ (hash >> 32);
+	}
+
+	static bool Equals(const Entry& entry, const LookupCacheKey& key)
+	{
+		return entry.operation == key.operation && entry.verbosity == key.verbosity && entry.maxEditDistance == key.maxEditDistance
+			&& entry.includeUnknown == key.includeUnknown && entry.input == key.input;
+	}
+
+	static size_t Bytes(const LookupCacheKey& key, const vector<SuggestItem>& result)
+	{
+		size_t bytes = sizeof(Entry) + sizeof(pair<uint64_t, uint32_t>) * 2 + key.input.size() * sizeof(xchar) + result.size() * sizeof(SuggestItem);
+		for (const SuggestItem& item : result) bytes += item.term.size() * sizeof(xchar);
+		return bytes;
+	}
+
+	Shard& ShardOf(uint64_t hash) { return shards[shardShift < 64 ? (size_t)(hash >> shardShift) : 0]; }
+
+	static void Remove(Shard& shard, uint32_t slot)
+	{
+		Entry& entry = shard.entries[slot];
+		shard.index.erase(entry.hash);
+		shard.bytes -= entry.bytes;
+		entry.used = false;
+		entry.input.clear();
+		entry.result.clear();
+		shard.unused.push_back(slot);
+	}
+
+	// advance the clock hand until a result that was not used recently is evicted
+	static void Evict(Shard& shard)
+	{
+		for (;;)
+		{
+			if (shard.hand >= shard.entries.size()) shard.hand = 0;
+			Entry& entry = shard.entries[shard.hand];
+			uint32_t slot = (uint32_t)shard.hand++;
+			if (!entry.used) continue;
+			if (entry.referenced)
+			{
+				entry.referenced = false;
+				continue;
+			}
+			Remove(shard, slot);
+			shard.evictions++;
+			return;
+		}
+	}
+
+public:
+	/// <summary>Create a new cache.</summary>
+	/// <param name="byteBudget">The maximum estimated memory use of the cached results.</param>
+	/// <param name="shardCount">The number of independently locked parts, rounded up to a power of two.</param>
+	LookupCache(size_t byteBudget, int shardCount = 16)
+	{
+		if (shardCount < 1) throw std::invalid_argument("shardCount");
+		int bits = 0;
+		while ((1 << bits) < shardCount) bits++;
+		shardShift = 64 - bits;
+		shards = vector<Shard>((size_t)1 << bits);
+		shardBudget = byteBudget >> bits;
+	}
+
+	/// <summary>Find the result of an operation.</summary>
+	/// <param name="key">The operation and its arguments.</param>
+	/// <param name="generation">The current generation of the dictionary.</param>
+	/// <param name="result">Receives the result, if it is in the cache.</param>
+	/// <returns>True if the result was in the cache.</returns>
+	bool Get(const LookupCacheKey& key, uint64_t generation, vector<SuggestItem>& result)
+	{
+		uint64_t hash = Hash(key);
+		Shard& shard = ShardOf(hash);
+		lock_guard<mutex> lock(shard.lock);
+		auto found = shard.index.find(hash);
+		if (found != shard.index.end())
+		{
+			Entry& entry = shard.entries[found->second];
+			if (entry.generation == generation && Equals(entry, key))
+			{
+				entry.referenced = true;
+				result = entry.result;
+				shard.hits++;
+				return true;
+			}
+			// computed for an older dictionary
+			if (entry.generation != generation) Remove(shard, found->second);
+		}
+		shard.misses++;
+		return false;
+	}
+
+	/// <summary>Add the result of an operation, evicting others if the byte budget is exceeded.</summary>
+	/// <param name="key">The operation and its arguments.</param>
+	/// <param name="generation">The generation of the dictionary the result was computed for.</param>
+	/// <param name="result">The result.</param>
+	void Put(const LookupCacheKey& key, uint64_t generation, const vector<SuggestItem>& result)
+	{
+		size_t bytes = Bytes(key, result);
+		if (bytes > shardBudget) return;
+		uint64_t hash = Hash(key);
+		Shard& shard = ShardOf(hash);
+		lock_guard<mutex> lock(shard.lock);
+		auto found = shard.index.find(hash);
+		if (found != shard.index.end()) Remove(shard, found->second);
+		while (shard.bytes + bytes > shardBudget) Evict(shard);
+
+		uint32_t slot;
+		if (!shard.unused.empty())
+		{
+			slot = shard.unused.back();
+			shard.unused.pop_back();
+		}
+		else
+		{
+			slot = (uint32_t)shard.entries.size();
+			shard.entries.emplace_back();
+		}
+		Entry& entry = shard.entries[slot];
+		entry.hash = hash;
+		entry.generation = generation;
+		entry.operation = key.operation;
+		entry.verbosity = key.verbosity;
+		entry.maxEditDistance = key.maxEditDistance;
+		entry.includeUnknown = key.includeUnknown;
+		entry.used = true;
+		entry.referenced = false;
+		entry.bytes = bytes;
+		entry.input.assign(key.input);
+		entry.result = result;
+		shard.index[hash] = slot;
+		shard.bytes += bytes;
+	}
+
+	/// <summary>Remove all results. The counters are kept.</summary>
+	void Clear()
+	{
+		for (Shard& shard : shards)
+		{
+			lock_guard<mutex> lock(shard.lock);
+			shard.entries.clear();
+			shard.unused.clear();
+			shard.index.clear();
+			shard.hand = 0;
+			shard.bytes = 0;
+		}
+	}
+
+	/// <summary>Current counters, summed over all shards.</summary>
+	LookupCacheStats Stats()
+	{
+		LookupCacheStats stats;
+		for (Shard& shard : shards)
+		{
+			lock_guard<mutex> lock(shard.lock);
+			stats.hits += shard.hits;
+			stats.misses += shard.misses;
+			stats.evictions += shard.evictions;
+			stats.entries += shard.index.size();
+			stats.bytes += shard.bytes;
+		}
+		return stats;
+	}
+};
@@ -0,0 +1,356 @@
+#pragma once
+#include "Helpers.h"
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+/// <summary>Events counted per Lookup by a SymSpell built with SYMSPELL_STATS.</summary>
+enum StatsCounter
+{
+	/// <summary>Candidates generated: the input prefix and its distinct deletes.</summary>
+	Candidates,
+	/// <summary>Candidate hashes looked up in the delete index.</summary>
+	DeleteProbes,
+	/// <summary>Probes that found a bucket.</summary>
+	DeleteHits,
+	/// <summary>Suggestions read from the buckets found.</summary>
+	BucketEntries,
+	/// <summary>Suggestions whose length differs from the input by more than the current best distance.</summary>
+	LengthRejections,
+	/// <summary>Suggestions shorter than or of the same length but different from the candidate (hash collisions).</summary>
+	CollisionRejections,
+	/// <summary>Suggestions whose prefix has more deletes than the current best distance.</summary>
+	PrefixRejections,
+	/// <summary>Suggestions with all edits in the prefix and a different suffix.</summary>
+	SuffixRejections,
+	/// <summary>Calls of DeleteInSuggestionPrefix.</summary>
+	DeleteInPrefixCalls,
+	/// <summary>Suggestions rejected by DeleteInSuggestionPrefix (hash collisions).</summary>
+	DeleteInPrefixRejections,
+	/// <summary>Suggestions that were considered already.</summary>
+	DuplicateRejections,
+	/// <summary>Edit distance calculations.</summary>
+	DistanceCalls,
+	/// <summary>Edit distance calculations that exceeded the current best distance.</summary>
+	DistanceRejections,
+	/// <summary>Candidates whose deletes were not generated, as they cannot lead to closer suggestions.</summary>
+	PrunedExpansions,
+	/// <summary>Buckets whose remaining suggestions were skipped, as none could beat the best Top suggestion.</summary>
+	BucketCutoffs,
+	/// <summary>Lookups that stopped before all candidates were processed.</summary>
+	EarlyTerminations,
+	/// <summary>Lookups answered by the cache.</summary>
+	CacheHits,
+	StatsCounterCount
+};
+
+/// <summary>Phases timed per query by a SymSpell built with SYMSPELL_STATS.</summary>
+enum StatsPhase
+{
+	/// <summary>A whole Lookup.</summary>
+	LookupTime,
+	/// <summary>A whole LookupCompound.</summary>
+	CompoundTime,
+	/// <summary>Lookups of the input terms of LookupCompound.</summary>
+	CompoundTermLookups,
+	/// <summary>Lookups and checks of terms combined with the previous term.</summary>
+	CompoundCombine,
+	/// <summary>Lookups and scoring of the splits of terms without a good correction.</summary>
+	CompoundSplit,
+	/// <summary>A whole WordSegmentation.</summary>
+	SegmentationTime,
+	/// <summary>Lookups of the parts of WordSegmentation, the rest is the composition.</summary>
+	SegmentationLookups,
+	StatsPhaseCount
+};
+
+/// <summary>The queries a LookupStats counts.</summary>
+enum StatsQuery
+{
+	LookupQuery,
+	LookupCompoundQuery,
+	WordSegmentationQuery,
+	StatsQueryCount
+};
+
+/// <summary>Counters and phase times of one query, which compile to nothing without SYMSPELL_STATS.</summary>
+class QueryStats
+{
+#ifdef SYMSPELL_STATS
+public:
+	uint64_t counters[StatsCounterCount];
+	uint64_t nanoseconds[StatsPhaseCount];
+	// phases that ran
+	uint32_t timed;
+
+	QueryStats() { Clear(); }
+	void Clear() { memset(this, 0, sizeof(*this)); }
+	void Count(StatsCounter counter, uint64_t n = 1) { counters[counter] += n; }
+	void Time(StatsPhase phase, uint64_t ns) { nanoseconds[phase] += ns; timed |= 1u << phase; }
+#else
+public:
+	void Clear() {}
+	void Count(StatsCounter, uint64_t = 1) {}
+#endif
+};
+
+/// <summary>Adds the time until it is destroyed to a phase of a QueryStats, only with SYMSPELL_STATS.</summary>
+class PhaseTimer
+{
+#ifdef SYMSPELL_STATS
+private:
+	QueryStats& stats;
+	StatsPhase phase;
+	chrono::steady_clock::time_point start;
+
+public:
+	PhaseTimer(QueryStats& stats, StatsPhase phase) : stats(stats), phase(phase), start(chrono::steady_clock::now()) {}
+	~PhaseTimer() { stats.Time(phase, (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count()); }
+#else
+public:
+	PhaseTimer(QueryStats&, StatsPhase) {}
+#endif
+};
+
+/// <summary>Distribution of a value in buckets of powers of two.</summary>
+struct StatsHistogram
+{
+	/// <summary>Number of values added.</summary>
+	uint64_t count = 0;
+	/// <summary>Sum of the values.</summary>
+	uint64_t sum = 0;
+	/// <summary>Largest value.</summary>
+	uint64_t max = 0;
+	/// <summary>buckets[0] counts zeros, buckets[b] the values from 2^(b-1) to 2^b-1.</summary>
+	uint64_t buckets[65] = { 0 };
+
+	static int Bucket(uint64_t value)
+	{
+		int bucket = 0;
+		while (bucket < 64 && (value >> bucket) != 0) bucket++;
+		return bucket;
+	}
+
+	/// <summary>Upper bound of the bucket of the value that p of all values are below, e.g. 0.99, at most max.</summary>
+	uint64_t Percentile(double p) const
+	{
+		uint64_t rank = (uint64_t)(p * count), seen = 0;
+		for (int b = 0; b < 65; b++)
+		{
+			seen += buckets[b];
+			if (seen > rank) return b == 0 ? 0 : b == 64 ? max : std::min(max, ((uint64_t)1 << b) - 1);
+		}
+		return max;
+	}
+
+	void Add(const StatsHistogram& other)
+	{
+		count += other.count;
+		sum += other.sum;
+		max = std::max(max, other.max);
+		for (int b = 0; b < 65; b++) buckets[b] += other.buckets[b];
+	}
+};
+
+/// <summary>The histograms of the queries of one thread, or of all threads.</summary>
+struct ThreadStats
+{
+	/// <summary>The thread, default constructed for the sum of all threads.</summary>
+	thread::id threadId;
+	/// <summary>Number of queries by kind.</summary>
+	uint64_t queries[StatsQueryCount] = { 0 };
+	/// <summary>Per Lookup values of the counters.</summary>
+	StatsHistogram counters[StatsCounterCount];
+	/// <summary>Per query nanoseconds of the phases, of the queries they ran in.</summary>
+	StatsHistogram phases[StatsPhaseCount];
+
+	void Add(const ThreadStats& other)
+	{
+		for (int q = 0; q < StatsQueryCount; q++) queries[q] += other.queries[q];
+		for (int c = 0; c < StatsCounterCount; c++) counters[c].Add(other.counters[c]);
+		for (int p = 0; p < StatsPhaseCount; p++) phases[p].Add(other.phases[p]);
+	}
+};
+
+/// <summary>A sink that aggregates the QueryStats of the queries of a SymSpell into per-thread histograms.</summary>
+/// <remarks>Only a SymSpell built with SYMSPELL_STATS records queries; otherwise the counters and timers are
+/// compiled out and the histograms stay empty. Every thread records into its own histograms without locking,
+/// and Threads and Total can be called at any time from any thread, e.g. to scrape them periodically.
+/// A sink may be shared by several SymSpell, and must outlive their queries.</remarks>
+class LookupStats
+{
+private:
+	struct RelaxedHistogram
+	{
+		atomic<uint64_t> count{ 0 };
+		atomic<uint64_t> sum{ 0 };
+		atomic<uint64_t> max{ 0 };
+		atomic<uint64_t> buckets[65];
+
+		RelaxedHistogram() { for (auto& bucket : buckets) bucket.store(0, memory_order_relaxed); }
+
+		// only the owning thread writes, so a relaxed load and store is enough
+		static void Increase(atomic<uint64_t>& value, uint64_t n) { value.store(value.load(memory_order_relaxed) + n, memory_order_relaxed); }
+
+		void Add(uint64_t value)
+		{
+			Increase(count, 1);
+			Increase(sum, value);
+			if (value > max.load(memory_order_relaxed)) max.store(value, memory_order_relaxed);
+			Increase(buckets[StatsHistogram::Bucket(value)], 1);
+		}
+
+		void Read(StatsHistogram& histogram) const
+		{
+			histogram.count = count.load(memory_order_relaxed);
+			histogram.sum = sum.load(memory_order_relaxed);
+			histogram.max = max.load(memory_order_relaxed);
+			for (int b = 0; b < 65; b++) histogram.buckets[b] = buckets[b].load(memory_order_relaxed);
+		}
+	};
+
+	struct alignas(64) Shard
+	{
+		thread::id threadId;
+		atomic<uint64_t> queries[StatsQueryCount];
+		RelaxedHistogram counters[StatsCounterCount];
+		RelaxedHistogram phases[StatsPhaseCount];
+
+		Shard(thread::id threadId) : threadId(threadId) { for (auto& count : queries) count.store(0, memory_order_relaxed); }
+	};
+
+	// sinks are told apart by id rather than address, which may be reused by a later sink
+	uint64_t id;
+	mutable mutex lock;
+	deque<Shard> shards;
+
+	static uint64_t NextId()
+	{
+		static atomic<uint64_t> ids(1);
+		return ids.fetch_add(1, memory_order_relaxed);
+	}
+
+	// the shard of the calling thread, cached for the sink it last recorded to
+	Shard& Local()
+	{
+		struct Cache
+		{
+			uint64_t sink = 0;
+			Shard* shard = nullptr;
+		};
+		static thread_local Cache cache;
+		if (cache.sink != id)
+		{
+			lock_guard<mutex> guard(lock);
+			thread::id self = this_thread::get_id();
+			Shard* found = nullptr;
+			for (Shard& shard : shards)
+			{
+				if (shard.threadId == self) found = &shard;
+			}
+			if (found == nullptr)
+			{
+				shards.emplace_back(self);
+				found = &shards.back();
+			}
+			cache.sink = id;
+			cache.shard = found;
+		}
+		return *cache.shard;
+	}
+
+public:
+	LookupStats() : id(NextId()) {}
+
+	/// <summary>Add the counters and phase times of a query to the histograms of the calling thread.</summary>
+	void Record(StatsQuery query, const QueryStats& stats)
+	{
+#ifdef SYMSPELL_STATS
+		Shard& shard = Local();
+		RelaxedHistogram::Increase(shard.queries[query], 1);
+		if (query == LookupQuery)
+		{
+			for (int c = 0; c < StatsCounterCount; c++) shard.counters[c].Add(stats.counters[c]);
+		}
+		for (int p = 0; p < StatsPhaseCount; p++)
+		{
+			if (stats.timed & (1u << p)) shard.phases[p].Add(stats.nanoseconds[p]);
+		}
+#else
+		(void)query;
+		(void)stats;
+#endif
+	}
+
+	/// <summary>The histograms of every thread that recorded queries.</summary>
+	vector<ThreadStats> Threads() const
+	{
+		lock_guard<mutex> guard(lock);
+		vector<ThreadStats> threads(shards.size());
+		for (size_t i = 0; i < shards.size(); i++)
+		{
+			threads[i].threadId = shards[i].threadId;
+			for (int q = 0; q < StatsQueryCount; q++) threads[i].queries[q] = shards[i].queries[q].load(memory_order_relaxed);
+			for (int c = 0; c < StatsCounterCount; c++) shards[i].counters[c].Read(threads[i].counters[c]);
+			for (int p = 0; p < StatsPhaseCount; p++) shards[i].phases[p].Read(threads[i].phases[p]);
+		}
+		return threads;
+	}
+
+	/// <summary>The histograms of all threads added up.</summary>
+	ThreadStats Total() const
+	{
+		ThreadStats total;
+		for (const ThreadStats& thread : Threads()) total.Add(thread);
+		return total;
+	}
+
+	/// <summary>Name of a counter, e.g. for exporting the histograms.</summary>
+	static const char* Name(StatsCounter counter)
+	{
+		static const char* names[] = { "candidates", "delete_probes", "delete_hits", "bucket_entries", "length_rejections",
+			"collision_rejections", "prefix_rejections", "suffix_rejections", "delete_in_prefix_calls", "delete_in_prefix_rejections",
+			"duplicate_rejections", "distance_calls", "distance_rejections", "pruned_expansions", "bucket_cutoffs", "early_terminations", "cache_hits" };
+		static_assert(sizeof(names) / sizeof(names[0]) == StatsCounterCount, "a name for every counter");
+		return names[counter];
+	}
+
+	/// <summary>Name of a phase, e.g. for exporting the histograms.</summary>
+	static const char* Name(StatsPhase phase)
+	{
+		static const char* names[] = { "lookup", "compound", "compound_term_lookups", "compound_combine", "compound_split",
+			"segmentation", "segmentation_lookups" };
+		static_assert(sizeof(names) / sizeof(names[0]) == StatsPhaseCount, "a name for every phase");
+		return names[phase];
+	}
+
+	/// <summary>Name of a kind of query.</summary>
+	static const char* Name(StatsQuery query)
+	{
+		static const char* names[] = { "lookup", "lookup_compound", "word_segmentation" };
+		static_assert(sizeof(names) / sizeof(names[0]) == StatsQueryCount, "a name for every query");
+		return names[query];
+	}
+};
+
+/// <summary>Records a QueryStats to a sink when it is destroyed, only with SYMSPELL_STATS.</summary>
+/// <remarks>Declared before the PhaseTimer of the whole query, so that the query is recorded with its time.</remarks>
+class StatsRecorder
+{
+#ifdef SYMSPELL_STATS
+private:
+	LookupStats* sink;
+	StatsQuery query;
+	const QueryStats& stats;
+
+public:
+	StatsRecorder(LookupStats* sink, StatsQuery query, const QueryStats& stats) : sink(sink), query(query), stats(stats) {}
+	~StatsRecorder() { if (sink != nullptr) sink->Record(query, stats); }
+#else
+public:
+	StatsRecorder(LookupStats*, StatsQuery, const QueryStats&) {}
+#endif
+};
@@ -0,0 +1,217 @@
+#pragma once
+#include "Helpers.h"
+#include <fstream>
+#include <memory>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#define SNAPSHOT_MAGIC "SYMSPELL"
+#define SNAPSHOT_VERSION 8
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+/// <summary>Fixed size header at the start of a snapshot file.</summary>
+/// <remarks>A snapshot is position independent: the header is followed by a payload of
+/// records, each 8-byte aligned relative to the file start, that only refer to each other
+/// by position. The payload can therefore be memory mapped and used in place.</remarks>
+struct SnapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t charSize;
+	int32_t maxDictionaryEditDistance;
+	int32_t prefixLength;
+	int32_t compactMask;
+	int32_t maxDictionaryWordLength;
+	int32_t utf8;
+	int64_t bigramCountMin;
+	uint64_t payloadSize;
+	uint64_t checksum;
+};
+
+/// <summary>64-bit FNV-1a variant over 8-byte words, used to detect corrupted snapshots.</summary>
+class SnapshotChecksum
+{
+private:
+	uint64_t hash = 14695981039346656037ULL;
+
+public:
+	/// <summary>Add data to the checksum. Size must be a multiple of 8 bytes.</summary>
+	void Add(const char* data, size_t size)
+	{
+		for (size_t i = 0; i < size; i += 8)
+		{
+			uint64_t word;
+			memcpy(&word, data + i, 8);
+			hash ^= word;
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	uint64_t Value() const { return hash; }
+};
+
+/// <summary>Writes the records of a snapshot payload to a stream.</summary>
+class SnapshotWriter
+{
+private:
+	ofstream& out;
+	SnapshotChecksum checksum;
+	uint64_t size = 0;
+
+	void Write(const char* data, size_t bytes)
+	{
+		static const char padding[8] = { 0 };
+		out.write(data, bytes);
+		checksum.Add(data, bytes & ~(size_t)7);
+		size_t tail = bytes & 7;
+		if (tail != 0)
+		{
+			char last[8] = { 0 };
+			memcpy(last, data + (bytes & ~(size_t)7), tail);
+			out.write(padding, 8 - tail);
+			checksum.Add(last, 8);
+		}
+		size += (bytes + 7) & ~(size_t)7;
+	}
+
+public:
+	SnapshotWriter(ofstream& out) : out(out) {}
+
+	template <class T>
+	void Value(T& value)
+	{
+		static_assert(sizeof(T) <= 8, "snapshot values are limited to 8 bytes");
+		char buffer[8] = { 0 };
+		memcpy(buffer, &value, sizeof(T));
+		Write(buffer, 8);
+	}
+
+	template <class T>
+	void Array(FlatArray<T>& array)
+	{
+		uint64_t count = array.size();
+		Value(count);
+		if (count != 0) Write((const char*)array.data(), count * sizeof(T));
+	}
+
+	uint64_t Size() const { return size; }
+	uint64_t Checksum() const { return checksum.Value(); }
+};
+
+/// <summary>Attaches data structures to the records of a snapshot payload in memory.</summary>
+class SnapshotReader
+{
+private:
+	const char* position;
+	const char* end;
+	bool valid = true;
+
+public:
+	SnapshotReader(const char* payload, size_t size) : position(payload), end(payload + size) {}
+
+	/// <summary>False if a record exceeded the payload.</summary>
+	bool Valid() const { return valid; }
+
+	template <class T>
+	void Value(T& value)
+	{
+		if (!valid || end - position < 8) { valid = false; return; }
+		memcpy(&value, position, sizeof(T));
+		position += 8;
+	}
+
+	template <class T>
+	void Array(FlatArray<T>& array)
+	{
+		uint64_t count = 0;
+		Value(count);
+		uint64_t bytes = (count * sizeof(T) + 7) & ~(uint64_t)7;
+		if (!valid || count > (uint64_t)(end - position) / sizeof(T) || bytes > (uint64_t)(end - position)) { valid = false; return; }
+		array.Attach((const T*)position, count);
+		position += bytes;
+	}
+};
+
+/// <summary>A file mapped read-only into memory.</summary>
+class MappedFile
+{
+private:
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+
+public:
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (data != nullptr) UnmapViewOfFile(data);
+		if (mapping != NULL) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+		if (data != nullptr) munmap((void*)data, size);
+#endif
+	}
+
+	/// <summary>Map a file.</summary>
+	/// <returns>True if the file was mapped, or false if it could not be opened or is empty.</returns>
+	bool Open(const string& path)
+	{
+#ifdef _WIN32
+		// shared for deletion, so that a new version of the file can be renamed over it while it is mapped
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return false;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) return false;
+		data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == nullptr) return false;
+		size = (size_t)fileSize.QuadPart;
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) { close(fd); return false; }
+		void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (mapped == MAP_FAILED) return false;
+		data = (const char*)mapped;
+		size = info.st_size;
+#endif
+		return true;
+	}
+
+	const char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+	/// <summary>Rename a file over another one, which stays readable through existing mappings.</summary>
+	/// <returns>True if the file was renamed.</returns>
+	static bool Replace(const string& from, const string& to)
+	{
+#ifdef _WIN32
+		return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		return rename(from.c_str(), to.c_str()) == 0;
+#endif
+	}
+};
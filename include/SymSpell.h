@@ -8,9 +8,16 @@
 #include <locale>
 #include <regex>
 #include <iostream>
+#include <thread>
 
 //#define UNICODE_SUPPORT
+//#define SYMSPELL_TRACK_MEMORY
+//#define SYMSPELL_STATS
 #include "Helpers.h"
+#include "LookupCache.h"
+#include "LookupStats.h"
+#include "Snapshot.h"
+#include "WorkStealingPool.h"
 
 
 // SymSpell: 1 million times faster through Symmetric Delete spelling correction algorithm
@@ -109,6 +116,18 @@ public:
 	};
 };
 
+/// <summary>A line of a dictionary file that could not be loaded.</summary>
+class LoadError
+{
+public:
+	/// <summary>Line number, starting at 1.</summary>
+	int64_t line;
+	/// <summary>The content of the line.</summary>
+	xstring text;
+
+	LoadError(int64_t line, xstring_view text) : line(line), text(text) {}
+};
+
 /// <summary>Controls the closeness/quantity of returned spelling suggestions.</summary>
 enum Verbosity
 {
@@ -121,6 +140,142 @@ enum Verbosity
 	All
 };
 
+/// <summary>Dictionary parameters a Lookup implementation is compiled for.</summary>
+/// <remarks>SymSpell::Lookup runs an implementation specialized for the maximum dictionary edit distance
+/// and prefix length of the dictionary, if one is compiled in, and the generic SymSpellEngine&lt;0, 0&gt;
+/// otherwise. A specialization keeps its candidates in fixed size buffers on the stack, and loops over the
+/// prefix have constant bounds. 0 means the parameter is only known at runtime.</remarks>
+template <int MaxEditDistance, int PrefixLength>
+struct SymSpellEngine
+{
+	static const int maxEditDistance = MaxEditDistance;
+	static const int prefixLength = PrefixLength;
+
+	/// <summary>True if this engine is compiled for a dictionary with these parameters.</summary>
+	static bool Matches(int maxDictionaryEditDistance, int prefixLength)
+	{
+		return (MaxEditDistance == 0 || MaxEditDistance == maxDictionaryEditDistance) && (PrefixLength == 0 || PrefixLength == prefixLength);
+	}
+
+	/// <summary>Upper bound of the candidates of a lookup: the prefix and all of its deletes of up to MaxEditDistance chars.</summary>
+	static constexpr size_t MaxCandidates()
+	{
+		size_t candidates = 0, combinations = 1;
+		for (int d = 0; d <= MaxEditDistance && d <= PrefixLength; d++)
+		{
+			candidates += combinations;
+			combinations = combinations * (PrefixLength - d) / (d + 1);
+		}
+		return candidates;
+	}
+
+	/// <summary>Upper bound of the total length of the candidates of a lookup.</summary>
+	static constexpr size_t MaxCandidateChars()
+	{
+		size_t chars = 0, combinations = 1;
+		for (int d = 0; d <= MaxEditDistance && d <= PrefixLength; d++)
+		{
+			chars += combinations * (PrefixLength - d);
+			combinations = combinations * (PrefixLength - d) / (d + 1);
+		}
+		return chars;
+	}
+};
+
+/// <summary>Reusable scratch state for SymSpell::Lookup.</summary>
+/// <remarks>A context holds the candidate queue, the sets of considered deletes and suggestions
+/// and the match masks of the input for the edit distance algorithm. Passing the same context to
+/// many lookups avoids heap allocations once the buffers have grown to their working size. A context must only be
+/// used by one thread at a time, while any number of threads may look up in the same SymSpell.</remarks>
+class LookupContext
+{
+	friend class SymSpell;
+
+private:
+	struct Match
+	{
+		uint32_t id;
+		int distance;
+		int64_t count;
+	};
+
+	// candidates (input prefix and its deletes) are stored back to back, in the order they are processed,
+	// unless the lookup is specialized for the dictionary parameters and keeps them on the stack
+	vector<xchar> candidateChars;
+	vector<uint32_t> candidateStarts;
+	vector<int> candidateHashes;
+	// deletes we've considered already (by candidate index)
+	ScratchSet consideredDeletes;
+	// suggestions we've considered already (by word id)
+	ScratchSet consideredSuggestions;
+	// prefix hashes of the candidate whose deletes are generated
+	PrefixHashes candidatePrefixes;
+	// match masks of the input, that candidates are verified against
+	BitParallelDistance inputPattern;
+	vector<Match> matches;
+	// in UTF-8 mode: the code points of the input, the candidates of a lookup of code points,
+	// and the decoded suggestion and candidate that are verified
+	u32string inputCodePoints;
+	vector<char32_t> candidateCodePoints;
+	u32string suggestionCodePoints;
+	u32string candidateCopy;
+	// counters of the current lookup, with SYMSPELL_STATS
+	QueryStats stats;
+
+	template <class Char>
+	vector<Char>& CandidateChars()
+	{
+		if constexpr (is_same<Char, xchar>::value) return candidateChars;
+		else return candidateCodePoints;
+	}
+};
+
+/// <summary>Memory use of the data structures of a SymSpell, in bytes.</summary>
+/// <remarks>Arrays are measured by their capacity, strings by the chars they allocated. The nodes and buckets
+/// of hash maps are estimated, unless SYMSPELL_TRACK_MEMORY is defined, where the maps count their allocations
+/// and all numbers are exact. Overhead of the heap allocator is not included. Arrays that refer to an opened
+/// snapshot are counted in mapped, not in the structures.</remarks>
+struct MemoryUsage
+{
+	/// <summary>The word table: chars, offsets, counts and hash slots or perfect hash.</summary>
+	size_t words = 0;
+	/// <summary>The part of words still held by removed words: their chars, offsets and counts, until they are reclaimed.</summary>
+	size_t removedWords = 0;
+	/// <summary>The words below the count threshold: hash map nodes and buckets, and their chars.</summary>
+	size_t belowThresholdWords = 0;
+	/// <summary>The hash slots of the delete index.</summary>
+	size_t deleteSlots = 0;
+	/// <summary>The word ids of all delete buckets.</summary>
+	size_t deleteIds = 0;
+	/// <summary>The bigram table: words, rows and counts.</summary>
+	size_t bigrams = 0;
+	/// <summary>The staged deletes of the SuggestionStage passed to MemoryReport, if any.</summary>
+	size_t staging = 0;
+	/// <summary>Sum of the above.</summary>
+	size_t total = 0;
+	/// <summary>Bytes of the snapshot file the structures refer to.</summary>
+	size_t mapped = 0;
+	/// <summary>Number of delete hashes (buckets).</summary>
+	size_t deleteHashes = 0;
+	/// <summary>Average number of word ids per bucket.</summary>
+	double averageBucketSize = 0;
+	/// <summary>Number of word ids in the largest bucket.</summary>
+	uint32_t maxBucketSize = 0;
+	/// <summary>True if the hash maps counted their allocations (SYMSPELL_TRACK_MEMORY).</summary>
+	bool exact = false;
+};
+
+/// <summary>Number of words changed by SymSpell::ApplyDelta.</summary>
+struct DeltaStats
+{
+	/// <summary>Words that became correctly spelled words.</summary>
+	int64_t added = 0;
+	/// <summary>Words whose count changed, without becoming or ceasing to be correctly spelled words.</summary>
+	int64_t updated = 0;
+	/// <summary>Words that were removed from the correctly spelled words.</summary>
+	int64_t removed = 0;
+};
+
 class SymSpell
 {
 protected:
@@ -131,34 +286,101 @@ protected:
 	int compactMask;
 	DistanceAlgorithm distanceAlgorithm = DistanceAlgorithm::DamerauOSADistance;
 	int maxDictionaryWordLength; //maximum dictionary term length
-	// Dictionary that contains a mapping of lists of suggested correction words to the hashCodes
+	int buildThreads = 0; //threads generating deletes in LoadDictionary/CreateDictionary, 0 = hardware concurrency
+	bool specializedLookup = true; //use a Lookup implementation compiled for the dictionary parameters, if there is one
+	bool utf8 = false; //words are UTF-8 encoded, and their lengths, deletes and edit distances are those of code points
+	// Index that contains a mapping of lists of suggested correction words to the hashCodes
 	// of the original words and the deletes derived from them. Collisions of hashCodes is tolerated,
 	// because suggestions are ultimately verified via an edit distance function.
 	// A list of suggestions might have a single suggestion, or multiple suggestions. 
-	Dictionary<int, vector<xstring>> *deletes = NULL;
-	// Dictionary of unique correct spelling words, and the frequency count for each word.
-	Dictionary<xstring, int64_t> words;
+	// Suggestions are stored as ids into words.
+	DeleteIndex deletes;
+	// Table of unique correct spelling words, and the frequency count for each word.
+	WordTable words;
 	// Dictionary of unique words that are below the count threshold for being considered correct spellings.
-	Dictionary<xstring, int64_t> belowThresholdWords;
+	MeasuredDictionary<xstring, int64_t> belowThresholdWords;
+	// Snapshot file the data structures above refer to, if opened with OpenSnapshot.
+	shared_ptr<MappedFile> snapshot;
+	// Lines the last LoadDictionary or LoadBigramDictionary call could not parse.
+	vector<LoadError> loadErrors;
+	// Optional cache of Lookup and LookupCompound results.
+	shared_ptr<LookupCache> cache;
+	// Optional sink of the counters and phase times of queries, with SYMSPELL_STATS.
+	shared_ptr<LookupStats> stats;
+	// Incremented by every change of the dictionary, to invalidate cached results.
+	uint64_t generation = 0;
 
 public:
 	/// <summary>Maximum edit distance for dictionary precalculation.</summary>
-	int MaxDictionaryEditDistance();
+	int MaxDictionaryEditDistance() const;
 
 		/// <summary>Length of prefix, from which deletes are generated.</summary>
-	int PrefixLength();
+	int PrefixLength() const;
 
 		/// <summary>Length of longest word in the dictionary.</summary>
-	int MaxLength();
+	int MaxLength() const;
 
 		/// <summary>Count threshold for a word to be considered a valid word for spelling correction.</summary>
-	long CountThreshold();
+	long CountThreshold() const;
 
 		/// <summary>Number of unique words in the dictionary.</summary>
-	int WordCount();
+	int WordCount() const;
 
 		/// <summary>Number of word prefixes and intermediate word deletes encoded in the dictionary.</summary>
-	int EntryCount();
+	int EntryCount() const;
+
+		/// <summary>Lines the last LoadDictionary or LoadBigramDictionary call could not parse, and skipped.</summary>
+	const vector<LoadError>& LoadErrors() const;
+
+		/// <summary>Bytes used by the words, deletes and bigrams, and the fan-out of the delete buckets.</summary>
+		/// <remarks>Exact if SYMSPELL_TRACK_MEMORY is defined, otherwise the hash maps are estimated.</remarks>
+		/// <param name="staging">Optional staging object whose staged deletes are included.</param>
+	MemoryUsage MemoryReport(const SuggestionStage* staging = nullptr) const;
+
+		/// <summary>Number of threads generating deletes in LoadDictionary and CreateDictionary.</summary>
+	int BuildThreads() const;
+
+		/// <summary>Set the number of threads generating deletes in LoadDictionary and CreateDictionary.</summary>
+		/// <remarks>The resulting dictionary is identical for any number of threads.</remarks>
+		/// <param name="threads">The number of threads, 0 = one per hardware thread.</param>
+	void SetBuildThreads(int threads);
+
+		/// <summary>True if Lookup uses an implementation specialized for the dictionary parameters, if there is one.</summary>
+	bool SpecializedLookup() const;
+
+		/// <summary>Enable or disable the Lookup implementations specialized for the dictionary parameters.</summary>
+		/// <remarks>Specializations are compiled for a maximum dictionary edit distance of 1 with prefix length 5,
+		/// and of 2 with prefix length 7. They return the same suggestions as the generic implementation.</remarks>
+		/// <param name="enabled">False to always use the generic implementation.</param>
+	void SetSpecializedLookup(bool enabled);
+
+		/// <summary>True if words are UTF-8 encoded, and their lengths, deletes and edit distances are those of code points.</summary>
+	bool Utf8Mode() const;
+
+		/// <summary>Treat words as UTF-8 encoded text, instead of as chars.</summary>
+		/// <remarks>Only without UNICODE_SUPPORT, and before any words are added. Words are stored as UTF-8, and decoded
+		/// only if they are not ASCII, so ASCII words are handled as fast as without UTF-8 mode. Malformed bytes are
+		/// handled as a code point each. ParseWords and CreateDictionary find words of letters of the global locale,
+		/// like UNICODE_SUPPORT builds.</remarks>
+		/// <param name="enabled">True for UTF-8 mode.</param>
+	void SetUtf8Mode(bool enabled);
+
+		/// <summary>The cache of Lookup and LookupCompound results, or null if results are not cached.</summary>
+	const shared_ptr<LookupCache>& Cache() const;
+
+		/// <summary>Cache the results of Lookup and LookupCompound, including the lookups of words within
+		/// LookupCompound and WordSegmentation.</summary>
+		/// <remarks>Cached results are invalidated by any change of the dictionary.</remarks>
+		/// <param name="cache">The cache, or null to stop caching. Must not be shared with another SymSpell.</param>
+	void SetCache(shared_ptr<LookupCache> cache);
+
+		/// <summary>The sink of query counters and phase times, or null if queries are not measured.</summary>
+	const shared_ptr<LookupStats>& Stats() const;
+
+		/// <summary>Record the counters and phase times of Lookup, LookupCompound and WordSegmentation.</summary>
+		/// <remarks>Only if SYMSPELL_STATS is defined, otherwise the counters are compiled out and nothing is recorded.</remarks>
+		/// <param name="stats">The sink, or null to stop recording.</param>
+	void SetStats(shared_ptr<LookupStats> stats);
 
 		/// <summary>Create a new instanc of SymSpell.</summary>
 		/// <remarks>Specifying ann accurate initialCapacity is not essential, 
@@ -188,7 +410,25 @@ public:
 	/// existing correctly spelled word.</returns>
 	bool CreateDictionaryEntry(xstring key, int64_t count, SuggestionStage* staging);
 
-	Dictionary<xstring, long> bigrams;
+	/// <summary>Decrease the frequency count of a word, and remove it once it is below the count threshold.</summary>
+	/// <remarks>A word that is removed from the correctly spelled words is also removed from the suggestion lists
+	/// of its deletes, and kept as a below threshold word with its remaining count, if any. The length of the
+	/// longest dictionary word is not reduced. Once removed words are a quarter of the word table, their memory
+	/// is reclaimed and the words are numbered again, so words staged in a SuggestionStage must be committed first.</remarks>
+	/// <param name="key">The word to decrease the count of.</param>
+	/// <param name="count">The amount to decrease the frequency count by.</param>
+	/// <returns>True if the word was removed from the correctly spelled words, or false if it remains one,
+	/// was a below threshold word, or is not in the dictionary.</returns>
+	bool RemoveDictionaryEntry(xstring key, int64_t count);
+
+	/// <summary>Remove a word from the dictionary, whatever its frequency count.</summary>
+	/// <param name="key">The word to remove.</param>
+	/// <returns>True if the word was removed from the correctly spelled words, or false if it
+	/// was a below threshold word, or is not in the dictionary.</returns>
+	bool RemoveDictionaryEntry(xstring key);
+
+	// Bigrams ("word1 word2") and their frequency counts, by the pair of their words.
+	BigramTable bigrams;
 	int64_t bigramCountMin = MAXLONG;
 
 	/// <summary>Load multiple dictionary entries from a file of word/frequency count pairs</summary>
@@ -239,15 +479,62 @@ public:
 	/// <returns>True if stream loads.</returns>
 	bool CreateDictionary(xifstream& corpusStream);
 
+	/// <summary>Apply a file of dictionary changes, such as the difference between two versions of a dictionary file.</summary>
+	/// <remarks>Every line holds an operation, a word and a count, separated by separatorChars:
+	/// "+ word count" adds count to the count of the word, as CreateDictionaryEntry,
+	/// "= word count" sets the count of the word, adding or removing it as needed,
+	/// "- word count" decreases the count of the word, as RemoveDictionaryEntry, and
+	/// "- word" removes the word. The changes are made in place, without rebuilding the delete index.
+	/// Lines that cannot be parsed are skipped and reported by LoadErrors.</remarks>
+	/// <param name="delta">The path+filename of the file.</param>
+	/// <param name="stats">Optional counts of the words added, updated and removed.</param>
+	/// <param name="separatorChars">Separator characters between operation, word and count.</param>
+	/// <returns>True if file loaded, or false if file not found.</returns>
+	bool ApplyDelta(string delta, DeltaStats* stats = nullptr, xchar separatorChars = DEFAULT_SEPARATOR_CHAR);
+
+	/// <summary>Apply a stream of dictionary changes, see ApplyDelta(string, DeltaStats*, xchar).</summary>
+	/// <param name="deltaStream">The stream containing the changes.</param>
+	/// <param name="stats">Optional counts of the words added, updated and removed.</param>
+	/// <param name="separatorChars">Separator characters between operation, word and count.</param>
+	/// <returns>True if stream loads.</returns>
+	bool ApplyDelta(xifstream& deltaStream, DeltaStats* stats = nullptr, xchar separatorChars = DEFAULT_SEPARATOR_CHAR);
+
+	/// <summary>Save the precomputed dictionary to a binary snapshot file.</summary>
+	/// <remarks>The snapshot contains the words, their counts, the delete index and the bigrams,
+	/// but not the below threshold words. It can be opened with OpenSnapshot by an instance
+	/// with the same maxDictionaryEditDistance, prefixLength, compactLevel and UTF-8 mode.
+	/// The file is written to path + ".tmp" and then renamed over path, so a snapshot that is
+	/// opened, by this or other instances, can be saved over; its readers keep the old version.</remarks>
+	/// <param name="path">The path+filename of the snapshot file.</param>
+	/// <returns>True if the snapshot was written.</returns>
+	bool SaveSnapshot(string path);
+
+	/// <summary>Replace the dictionary by a binary snapshot file written by SaveSnapshot.</summary>
+	/// <remarks>The file is memory mapped read-only and queried in place, without deserialization.
+	/// Later dictionary updates copy the affected structures into memory first.</remarks>
+	/// <param name="path">The path+filename of the snapshot file.</param>
+	/// <returns>True if the snapshot was opened, or false if the file was not found, is corrupted,
+	/// or was built with different maxDictionaryEditDistance, prefixLength, compactLevel, character width or UTF-8 mode.</returns>
+	bool OpenSnapshot(string path);
+
 	/// <summary>Remove all below threshold words from the dictionary.</summary>
 	/// <remarks>This can be used to reduce memory consumption after populating the dictionary from
 	/// a corpus using CreateDictionary.</remarks>
 	void PurgeBelowThresholdWords();
 
+	/// <summary>Find the words of the dictionary and of the bigrams by minimal perfect hashes, once the dictionary no longer changes.</summary>
+	/// <remarks>The hash slots of 8 to 16 bytes per word are replaced by less than a byte per word, while an exact match
+	/// takes one hash, a few more memory accesses than with hash slots, and at most one comparison. The words are
+	/// numbered in the order of the perfect hash, and removed words are dropped, so suggestions staged before are
+	/// to be committed first. Results do not change. The next change of the words goes back to hash slots, so Freeze
+	/// again after updates. Frozen tables are kept by SaveSnapshot.</remarks>
+	void Freeze();
+
 	/// <summary>Commit staged dictionary additions.</summary>
 	/// <remarks>Used when you write your own process to load multiple words into the
 	/// dictionary, and as part of that process, you first created a SuggestionsStage 
-	/// object, and passed that to CreateDictionaryEntry calls.</remarks>
+	/// object, and passed that to CreateDictionaryEntry calls. The suggestions of every
+	/// delete are then ordered by descending count.</remarks>
 	/// <param name="staging">The SuggestionStage object storing the staged data.</param>
 	void CommitStaged(SuggestionStage* staging);
 
@@ -257,7 +544,7 @@ public:
 	/// <param name="verbosity">The value controlling the quantity/closeness of the retuned suggestions.</param>
 	/// <returns>A List of SuggestItem object representing suggested correct spellings for the input word, 
 	/// sorted by edit distance, and secondarily by count frequency.</returns>
-	vector<SuggestItem> Lookup(xstring input, Verbosity verbosity);
+	vector<SuggestItem> Lookup(xstring input, Verbosity verbosity) const;
 
 	/// <summary>Find suggested spellings for a given input word, using the maximum
 	/// edit distance specified during construction of the SymSpell dictionary.</summary>
@@ -266,7 +553,7 @@ public:
 	/// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
 	/// <returns>A List of SuggestItem object representing suggested correct spellings for the input word, 
 	/// sorted by edit distance, and secondarily by count frequency.</returns>
-	vector<SuggestItem> Lookup(xstring input, Verbosity verbosity, int maxEditDistance);
+	vector<SuggestItem> Lookup(xstring input, Verbosity verbosity, int maxEditDistance) const;
 
 	/// <summary>Find suggested spellings for a given input word.</summary>
 	/// <param name="input">The word being spell checked.</param>
@@ -275,23 +562,96 @@ public:
 	/// <param name="includeUnknown">Include input word in suggestions, if no words within edit distance found.</param>																													   
 	/// <returns>A List of SuggestItem object representing suggested correct spellings for the input word, 
 	/// sorted by edit distance, and secondarily by count frequency.</returns>
-	vector<SuggestItem> Lookup(xstring input, Verbosity verbosity, int maxEditDistance, bool includeUnknown);
+	vector<SuggestItem> Lookup(xstring input, Verbosity verbosity, int maxEditDistance, bool includeUnknown) const;
+
+	/// <summary>Find suggested spellings for a given input word, reusing the buffers of a context.</summary>
+	/// <remarks>Lookups do not modify the dictionary, so any number of threads can look up concurrently,
+	/// each with its own context. The Lookup overloads without a context use one context per thread.</remarks>
+	/// <param name="input">The word being spell checked.</param>
+	/// <param name="verbosity">The value controlling the quantity/closeness of the retuned suggestions.</param>
+	/// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
+	/// <param name="includeUnknown">Include input word in suggestions, if no words within edit distance found.</param>
+	/// <param name="context">Scratch state, used by only one thread at a time.</param>
+	/// <param name="suggestions">Receives the SuggestItem objects representing suggested correct spellings for the input word, 
+	/// sorted by edit distance, and secondarily by count frequency. Existing items are reused.</param>
+	void Lookup(xstring_view input, Verbosity verbosity, int maxEditDistance, bool includeUnknown, LookupContext& context, vector<SuggestItem>& suggestions) const;
+
+	/// <summary>Find suggested spellings for many input words on multiple threads.</summary>
+	/// <remarks>Repeated input words are looked up only once.</remarks>
+	/// <param name="inputs">The words being spell checked.</param>
+	/// <param name="verbosity">The value controlling the quantity/closeness of the retuned suggestions.</param>
+	/// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
+	/// <param name="threads">The number of threads, 0 = one per hardware thread.</param>
+	/// <param name="results">Receives the suggestions for every input word, in input order, as returned by Lookup.</param>
+	void LookupBatch(const vector<xstring_view>& inputs, Verbosity verbosity, int maxEditDistance, int threads, vector<vector<SuggestItem>>& results) const;
 
 private:
+	//add or update a word and its count, without creating deletes
+	//returns true and the id of the word, if it was added as a new correctly spelled word,
+	//and false and the id of the word if the count of a correctly spelled word was updated, UINT32_MAX otherwise
+	bool AddWord(xstring_view key, int64_t count, uint32_t& id);
+
+	//parse word/frequency count pairs from the content of a dictionary file
+	bool ParseDictionary(xstring_view corpus, int termIndex, int countIndex, xchar separatorChars);
+
+	//parse and apply the changes of a delta file
+	bool ParseDelta(xstring_view delta, DeltaStats* stats, xchar separatorChars);
+
+	//frequency count of a correctly spelled or below threshold word, 0 if the word is unknown
+	int64_t CountOf(xstring_view key) const;
+
+	//parse bigram/frequency count pairs from the content of a bigram dictionary file
+	bool ParseBigramDictionary(xstring_view corpus, int termIndex, int countIndex, xchar separatorChars);
+
+	//create the deletes of new words on BuildThreads() threads and merge them into the delete index
+	void CommitDeletes(const vector<uint32_t>& newWords);
+
+	//drop the removed words from the word table, and renumber the word ids in the delete index
+	void CompactWords();
+
+	//move a word within the buckets of its deletes after its count changed, so that they stay in order of descending count
+	void RepositionWord(xstring_view key, uint32_t id);
+
+	//Lookup of the chars of input, or of its code points in UTF-8 mode, with the engine for the dictionary parameters
+	template <class Char>
+	void LookupChars(xstring_view input, basic_string_view<Char> chars, Verbosity verbosity, int maxEditDistance, bool includeUnknown, LookupContext& context, vector<SuggestItem>& suggestions) const;
+
+	//Lookup with the candidate buffers and the prefix length of an engine
+	template <class Engine, class Char>
+	void LookupWith(xstring_view input, basic_string_view<Char> chars, Verbosity verbosity, int maxEditDistance, bool includeUnknown, LookupContext& context, vector<SuggestItem>& suggestions) const;
+
 	//check whether all delete chars are present in the suggestion prefix in correct order, otherwise this is just a hash collision
-	bool DeleteInSuggestionPrefix(xstring deleteSugg, int deleteLen, xstring suggestion, int suggestionLen);
+	template <class Engine, class Char>
+	bool DeleteInSuggestionPrefix(basic_string_view<Char> deleteSugg, int deleteLen, basic_string_view<Char> suggestion, int suggestionLen) const;
+
+	//number of chars of a text, or of code points in UTF-8 mode
+	int CharCount(xstring_view text) const;
+
+	//start offsets of the chars of a text, or of its code points in UTF-8 mode, followed by the length of the text
+	void CharOffsets(xstring_view text, vector<int>& offsets) const;
+
+	//edit distance of two texts, of their code points in UTF-8 mode
+	int Compare(EditDistance& distance, xstring_view string1, xstring_view string2, int maxDistance) const;
 
 	//create a non-unique wordlist from sample text
 	//language independent (e.g. works with Chinese characters)
-	vector<xstring> ParseWords(xstring text);
+	vector<xstring_view> ParseWords(xstring_view text) const;
 
 	//inexpensive and language independent: only deletes, no transposes + replaces + inserts
 	//replaces and inserts are expensive and language dependent (Chinese has 70,000 Unicode Han characters)
-	HashSet<xstring>* Edits(xstring word, int editDistance, HashSet<xstring>* deleteWords);
+	void Edits(const PrefixHashes& prefixHashes, int from, int editDistance, uint64_t kept, vector<int>& editHashes) const;
+
+	//hashes of the prefix of key and of its deletes, without duplicates
+	void EditHashes(xstring_view key, PrefixHashes& prefixHashes, vector<int>& editHashes) const;
 
-	HashSet<xstring> EditsPrefix(xstring key);
+	//EditHashes of the chars or code points of a key
+	template <class Char>
+	void CharEditHashes(basic_string_view<Char> key, PrefixHashes& prefixHashes, vector<int>& editHashes) const;
 
-	int GetstringHash(xstring s);
+	int GetHash(uint64_t polynomial, int len) const;
+
+	template <class Char>
+	int GetstringHash(basic_string_view<Char> s) const;
 
 public:
 	//######################
@@ -304,13 +664,21 @@ public:
 	/// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
 	/// <param name="input">The string being spell checked.</param>																										   
 	/// <returns>A List of SuggestItem object representing suggested correct spellings for the input string.</returns> 
-	vector<SuggestItem> LookupCompound(xstring input);
+	vector<SuggestItem> LookupCompound(xstring input) const;
 
 	/// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
 	/// <param name="input">The string being spell checked.</param>
 	/// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>																											   
 	/// <returns>A List of SuggestItem object representing suggested correct spellings for the input string.</returns> 
-	vector<SuggestItem> LookupCompound(xstring input, int editDistanceMax);
+	vector<SuggestItem> LookupCompound(xstring input, int editDistanceMax) const;
+
+	/// <summary>Find suggested spellings for many multi-word input strings on multiple threads.</summary>
+	/// <remarks>Repeated input strings are corrected only once.</remarks>
+	/// <param name="inputs">The strings being spell checked.</param>
+	/// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
+	/// <param name="threads">The number of threads, 0 = one per hardware thread.</param>
+	/// <param name="results">Receives the suggestions for every input string, in input order, as returned by LookupCompound.</param>
+	void LookupCompoundBatch(const vector<xstring_view>& inputs, int editDistanceMax, int threads, vector<vector<SuggestItem>>& results) const;
 
 	//######
 
@@ -334,7 +702,7 @@ public:
 	/// the word segmented and spelling corrected string, 
 	/// the Edit distance sum between input string and corrected string, 
 	/// the Sum of word occurrence probabilities in log scale (a measure of how common and probable the corrected segmentation is).</returns> 
-	Info WordSegmentation(xstring input);
+	Info WordSegmentation(xstring input) const;
 
 	/// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
 	/// <param name="input">The string being spell checked.</param>
@@ -344,7 +712,7 @@ public:
 	/// the word segmented and spelling corrected string, 
 	/// the Edit distance sum between input string and corrected string, 
 	/// the Sum of word occurrence probabilities in log scale (a measure of how common and probable the corrected segmentation is).</returns> 
-	Info WordSegmentation(xstring input, int maxEditDistance);
+	Info WordSegmentation(xstring input, int maxEditDistance) const;
 
 	/// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
 	/// <param name="input">The string being spell checked.</param>
@@ -355,6 +723,15 @@ public:
 	/// the word segmented and spelling corrected string, 
 	/// the Edit distance sum between input string and corrected string, 
 	/// the Sum of word occurrence probabilities in log scale (a measure of how common and probable the corrected segmentation is).</returns> 
-	Info WordSegmentation(xstring input, int maxEditDistance, int maxSegmentationWordLength);
+	Info WordSegmentation(xstring input, int maxEditDistance, int maxSegmentationWordLength) const;
+
+	/// <summary>Segment many strings into words on multiple threads.</summary>
+	/// <remarks>Repeated input strings are segmented only once.</remarks>
+	/// <param name="inputs">The strings being segmented.</param>
+	/// <param name="maxEditDistance">The maximum edit distance between input and corrected words 
+	/// (0=no correction/segmentation only).</param>	
+	/// <param name="threads">The number of threads, 0 = one per hardware thread.</param>
+	/// <param name="results">Receives the segmentation of every input string, in input order, as returned by WordSegmentation.</param>
+	void WordSegmentationBatch(const vector<xstring_view>& inputs, int maxEditDistance, int threads, vector<Info>& results) const;
 };
 
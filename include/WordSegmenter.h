@@ -0,0 +1,127 @@
+#pragma once
+#include "SymSpell.h"
+#include <deque>
+
+/// <summary>A word of a segmented text.</summary>
+class SegmentedWord
+{
+public:
+	/// <summary>The part of the input that forms the word, without whitespace.</summary>
+	xstring segmented;
+	/// <summary>The spelling corrected word.</summary>
+	xstring corrected;
+};
+
+/// <summary>Word segmentation of a text that is passed in chunks, such as a stream of unbounded length.</summary>
+/// <remarks>Segments the same way as SymSpell::WordSegmentation, but words are returned as soon as no later
+/// input can change them, and only a window of the input is kept in memory. A word is final once the best
+/// segmentations of all positions that later words can start from agree on it, which usually happens within
+/// a few words. Otherwise, once more than 3 * maxSegmentationWordLength chars are undecided, the words of the best
+/// segmentation up to the current position are committed, and later positions only build on them; only
+/// then can the result differ from WordSegmentation. In UTF-8 mode, chars are code points, and chunks may
+/// be split anywhere. A segmenter must only be used by one thread at a time,
+/// and the SymSpell must not change while a text is segmented.</remarks>
+class WordSegmenter
+{
+private:
+	// best segmentation of the input up to a position
+	struct Position
+	{
+		xchar c; // the input char at the position, the first byte of the code point in UTF-8 mode
+		int compactPosition; // offset of the position in compact
+		int compactLength; // number of non-whitespace chars (code points in UTF-8 mode) before the position, since base
+		bool reached; // a segmentation up to the position was found
+		bool valid; // the segmentation builds on the committed words
+		int distance;
+		double probabilityLog;
+		int64_t start; // start of the last word
+		bool found; // the last word was found in the dictionary
+		xstring term; // the correction of the last word
+	};
+
+	// top spelling correction of a part
+	struct PartResult
+	{
+		bool known;
+		bool found;
+		int distance;
+		double probabilityLog;
+		xstring term;
+	};
+
+	const SymSpell& symSpell;
+	int maxEditDistance;
+	int maxSegmentationWordLength;
+	LookupContext context;
+	vector<SuggestItem> results;
+	// parts starting at the compact position rowStart, by length: the parts starting
+	// at whitespace and at the following chars are the same, and are looked up once
+	vector<PartResult> row;
+	int rowStart = -1;
+
+	// positions from base on, and the non-whitespace chars from base on
+	vector<Position> positions;
+	xstring compact;
+	// in UTF-8 mode, the start of a code point whose sequence is cut at the end of the last chunk
+	xstring pending;
+	int64_t base = 0;
+	// number of chars pushed
+	int64_t length = 0;
+	// next start position (column) to process; the segmentations up to it are final
+	int64_t column = 0;
+	// end of the committed words, all later segmentations build on
+	int64_t committed = 0;
+	int64_t lastCommitCheck = 0;
+	bool finished = false;
+	int committedDistance = 0;
+	double committedProbabilityLog = 0;
+	deque<SegmentedWord> words;
+	// scratch buffers of CommitFinal and Commit
+	vector<int> visits;
+	vector<int64_t> ends;
+
+	Position& At(int64_t position) { return positions[(size_t)(position - base)]; }
+	xstring_view Part(int64_t start, int64_t end);
+	int PartLength(int64_t start, int64_t end) { return At(end).compactLength - At(start).compactLength; }
+	void Reset();
+	void Append(xstring_view c);
+	void Relax(int64_t start, int64_t end, PartResult& part);
+	void ProcessColumn();
+	void Commit(int64_t position);
+	void CommitFinal();
+	void ForceCommit();
+	void Trim();
+
+public:
+	/// <summary>Create a new segmenter.</summary>
+	/// <param name="symSpell">The dictionary, which must outlive the segmenter.</param>
+	/// <param name="maxEditDistance">The maximum edit distance between input and corrected words
+	/// (0=no correction/segmentation only).</param>
+	/// <param name="maxSegmentationWordLength">The maximum word length that should be considered.</param>
+	WordSegmenter(const SymSpell& symSpell, int maxEditDistance, int maxSegmentationWordLength);
+
+	/// <summary>Create a new segmenter, considering words up to the length of the longest dictionary word.</summary>
+	WordSegmenter(const SymSpell& symSpell, int maxEditDistance);
+
+	/// <summary>Append a chunk of the text.</summary>
+	void Push(xstring_view chunk);
+
+	/// <summary>Mark the end of the text, so that its last words are committed. The next Push starts a new text.</summary>
+	void Finish();
+
+	/// <summary>Take the next committed word.</summary>
+	/// <param name="word">Receives the word.</param>
+	/// <returns>True if there was a committed word that was not taken yet.</returns>
+	bool Next(SegmentedWord& word);
+
+	/// <summary>Number of committed words that were not taken yet.</summary>
+	size_t Pending() const;
+
+	/// <summary>The edit distance sum between the input and the corrected words committed so far,
+	/// after Finish the same as Info::getDistance of WordSegmentation.</summary>
+	int DistanceSum() const;
+
+	/// <summary>The sum of word occurence probabilities in log scale of the words committed so far,
+	/// after Finish the same as Info::getProbability of WordSegmentation.</summary>
+	double ProbabilityLogSum() const;
+};
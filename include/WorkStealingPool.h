@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/// <summary>Runs loops over a range of indices on a number of threads, which steal work from each other.</summary>
+/// <remarks>Every thread starts with an equal share of the range and takes chunks from the front of it.
+/// A thread that has finished its share steals the back half of the remaining share of another thread,
+/// so an uneven cost per index does not leave threads idle. The calling thread takes part in the loop,
+/// the other threads only live for the duration of a For call.</remarks>
+class WorkStealingPool
+{
+private:
+	// remaining range of a thread, packed as (begin << 32 | end) so that it is updated by a single CAS
+	struct alignas(64) Share
+	{
+		atomic<uint64_t> range{ 0 };
+	};
+
+	int threads;
+
+	static uint64_t Pack(uint64_t begin, uint64_t end) { return (begin << 32) | end; }
+
+	// take a chunk from the front of the own share
+	static bool Take(Share& share, size_t grain, size_t& begin, size_t& end)
+	{
+		uint64_t range = share.range.load(memory_order_acquire);
+		for (;;)
+		{
+			begin = (size_t)(range >> 32);
+			end = (size_t)(range & 0xFFFFFFFF);
+			if (begin >= end) return false;
+			size_t next = min(begin + grain, end);
+			if (share.range.compare_exchange_weak(range, Pack(next, end), memory_order_acq_rel)) { end = next; return true; }
+		}
+	}
+
+	// take the back half of the share of another thread
+	static bool Steal(Share& victim, size_t& begin, size_t& end)
+	{
+		uint64_t range = victim.range.load(memory_order_acquire);
+		for (;;)
+		{
+			size_t first = (size_t)(range >> 32), last = (size_t)(range & 0xFFFFFFFF);
+			if (first >= last) return false;
+			size_t middle = first + (last - first) / 2;
+			if (victim.range.compare_exchange_weak(range, Pack(first, middle), memory_order_acq_rel)) { begin = middle; end = last; return true; }
+		}
+	}
+
+public:
+	/// <summary>Create a new pool.</summary>
+	/// <param name="threads">The number of threads, 0 = one per hardware thread.</param>
+	WorkStealingPool(int threads = 0)
+	{
+		if (threads < 0) throw std::invalid_argument("threads");
+		this->threads = threads > 0 ? threads : max(1, (int)thread::hardware_concurrency());
+	}
+
+	/// <summary>Number of threads running a loop.</summary>
+	int Threads() const { return threads; }
+
+	/// <summary>Call body(index, thread) for every index in [0, count), and wait until all calls returned.</summary>
+	/// <remarks>The thread argument is in [0, Threads()), and identifies the thread making the call,
+	/// so that the body can use per-thread state without synchronization. If a call throws, the remaining
+	/// indices are skipped and the first exception is rethrown.</remarks>
+	/// <param name="count">The number of indices, at most 2^32-1.</param>
+	/// <param name="grain">The number of indices a thread takes at once.</param>
+	/// <param name="body">The loop body.</param>
+	template <class Body>
+	void For(size_t count, size_t grain, Body body)
+	{
+		if (count > 0xFFFFFFFF) throw std::invalid_argument("count");
+		if (count == 0) return;
+		if (grain == 0) grain = 1;
+		int active = (int)min((size_t)threads, (count + grain - 1) / grain);
+		vector<Share> shares(active);
+		for (int t = 0; t < active; t++) shares[t].range.store(Pack(count * t / active, count * (t + 1) / active));
+
+		atomic<bool> failed{ false };
+		exception_ptr error;
+		mutex errorLock;
+		auto run = [&](int t)
+		{
+			try
+			{
+				size_t begin, end;
+				for (;;)
+				{
+					while (Take(shares[t], grain, begin, end))
+					{
+						for (size_t i = begin; i < end; i++) body(i, t);
+						if (failed.load(memory_order_relaxed)) return;
+					}
+					// own share is done, steal from the others starting with the next thread
+					bool stolen = false;
+					for (int v = 1; v < active && !stolen; v++)
+					{
+						if (Steal(shares[(t + v) % active], begin, end))
+						{
+							shares[t].range.store(Pack(begin, end), memory_order_release);
+							stolen = true;
+						}
+					}
+					if (!stolen) return;
+				}
+			}
+			catch (...)
+			{
+				lock_guard<mutex> lock(errorLock);
+				if (!error) error = current_exception();
+				failed = true;
+			}
+		};
+
+		vector<thread> workers;
+		for (int t = 1; t < active; t++) workers.emplace_back(run, t);
+		run(0);
+		for (thread& worker : workers) worker.join();
+		if (error) rethrow_exception(error);
+	}
+};
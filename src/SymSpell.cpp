@@ -1,39 +1,150 @@
 #include "SymSpell.h"
 #include <codecvt>
 /// <summary>Maximum edit distance for dictionary precalculation.</summary>
-int SymSpell::MaxDictionaryEditDistance()
+int SymSpell::MaxDictionaryEditDistance() const
 {
 	return this->maxDictionaryEditDistance; 
 }
 
 /// <summary>Length of prefix, from which deletes are generated.</summary>
-int SymSpell::PrefixLength()
+int SymSpell::PrefixLength() const
 {
 	return this->prefixLength;
 }
 
 /// <summary>Length of longest word in the dictionary.</summary>
-int SymSpell::MaxLength()
+int SymSpell::MaxLength() const
 {
 	return this->maxDictionaryWordLength;
 }
 
 /// <summary>Count threshold for a word to be considered a valid word for spelling correction.</summary>
-long SymSpell::CountThreshold()
+long SymSpell::CountThreshold() const
 {
 	return this->countThreshold;
 }
 
 /// <summary>Number of unique words in the dictionary.</summary>
-int SymSpell::WordCount()
+int SymSpell::WordCount() const
 {
-	return this->words.size();
+	return (int)this->words.LiveCount();
 }
 
 /// <summary>Number of word prefixes and intermediate word deletes encoded in the dictionary.</summary>
-int SymSpell::EntryCount()
+int SymSpell::EntryCount() const
 {
-	return this->deletes->size();
+	return this->deletes.Size();
+}
+
+/// <summary>Lines the last LoadDictionary or LoadBigramDictionary call could not parse, and skipped.</summary>
+const vector<LoadError>& SymSpell::LoadErrors() const
+{
+	return this->loadErrors;
+}
+
+/// <summary>Bytes used by the words, deletes and bigrams, and the fan-out of the delete buckets.</summary>
+/// <remarks>Exact if SYMSPELL_TRACK_MEMORY is defined, otherwise the hash maps are estimated.</remarks>
+/// <param name="staging">Optional staging object whose staged deletes are included.</param>
+MemoryUsage SymSpell::MemoryReport(const SuggestionStage* staging) const
+{
+	MemoryUsage report;
+	report.words = this->words.HeapBytes();
+	report.removedWords = this->words.RemovedBytes();
+	report.belowThresholdWords = MapBytes(this->belowThresholdWords);
+	for (auto& word : this->belowThresholdWords) report.belowThresholdWords += StringBytes(word.first);
+	report.deleteSlots = this->deletes.SlotBytes();
+	report.deleteIds = this->deletes.IdBytes();
+	report.bigrams = this->bigrams.HeapBytes();
+	if (staging != nullptr) report.staging = staging->HeapBytes();
+	report.total = report.words + report.belowThresholdWords + report.deleteSlots + report.deleteIds + report.bigrams + report.staging;
+	report.mapped = this->words.MappedBytes() + this->deletes.MappedBytes() + this->bigrams.MappedBytes();
+	report.deleteHashes = this->deletes.Size();
+	report.averageBucketSize = report.deleteHashes == 0 ? 0 : (double)this->deletes.IdCount() / report.deleteHashes;
+	report.maxBucketSize = this->deletes.MaxBucketSize();
+#ifdef SYMSPELL_TRACK_MEMORY
+	report.exact = true;
+#endif
+	return report;
+}
+
+/// <summary>Number of threads generating deletes in LoadDictionary and CreateDictionary.</summary>
+int SymSpell::BuildThreads() const
+{
+	if (this->buildThreads > 0) return this->buildThreads;
+	return max(1, (int)thread::hardware_concurrency());
+}
+
+/// <summary>Set the number of threads generating deletes in LoadDictionary and CreateDictionary.</summary>
+/// <remarks>The resulting dictionary is identical for any number of threads.</remarks>
+/// <param name="threads">The number of threads, 0 = one per hardware thread.</param>
+void SymSpell::SetBuildThreads(int threads)
+{
+	if (threads < 0) throw std::invalid_argument("threads");
+	this->buildThreads = threads;
+}
+
+/// <summary>True if Lookup uses an implementation specialized for the dictionary parameters, if there is one.</summary>
+bool SymSpell::SpecializedLookup() const
+{
+	return this->specializedLookup;
+}
+
+/// <summary>Enable or disable the Lookup implementations specialized for the dictionary parameters.</summary>
+/// <param name="enabled">False to always use the generic implementation.</param>
+void SymSpell::SetSpecializedLookup(bool enabled)
+{
+	this->specializedLookup = enabled;
+}
+
+/// <summary>True if words are UTF-8 encoded, and their lengths, deletes and edit distances are those of code points.</summary>
+bool SymSpell::Utf8Mode() const
+{
+	return this->utf8;
+}
+
+/// <summary>Treat words as UTF-8 encoded text, instead of as chars.</summary>
+/// <remarks>Only without UNICODE_SUPPORT, and before any words are added.</remarks>
+/// <param name="enabled">True for UTF-8 mode.</param>
+void SymSpell::SetUtf8Mode(bool enabled)
+{
+#ifdef UNICODE_SUPPORT
+	if (enabled) throw std::invalid_argument("enabled");
+#endif
+	if (enabled == this->utf8) return;
+	// the deletes of the words already added would be those of the other mode
+	if (this->words.Size() > 0 || !this->belowThresholdWords.empty()) throw std::invalid_argument("enabled");
+	this->utf8 = enabled;
+	this->generation++;
+}
+
+/// <summary>The cache of Lookup and LookupCompound results, or null if results are not cached.</summary>
+const shared_ptr<LookupCache>& SymSpell::Cache() const
+{
+	return this->cache;
+}
+
+/// <summary>Cache the results of Lookup and LookupCompound, including the lookups of words within
+/// LookupCompound and WordSegmentation.</summary>
+/// <remarks>Cached results are invalidated by any change of the dictionary.</remarks>
+/// <param name="cache">The cache, or null to stop caching. Must not be shared with another SymSpell.</param>
+void SymSpell::SetCache(shared_ptr<LookupCache> cache)
+{
+	this->cache = cache;
+	this->generation++;
+}
+
+/// <summary>The sink of query counters and phase times, or null if queries are not measured.</summary>
+const shared_ptr<LookupStats>& SymSpell::Stats() const
+{
+	return this->stats;
+}
+
+/// <summary>Record the counters and phase times of Lookup, LookupCompound and WordSegmentation.</summary>
+/// <remarks>Only if SYMSPELL_STATS is defined, otherwise the counters are compiled out and nothing is recorded.</remarks>
+/// <param name="stats">The sink, or null to stop recording.</param>
+void SymSpell::SetStats(shared_ptr<LookupStats> stats)
+{
+	this->stats = stats;
 }
 
 /// <summary>Create a new instanc of SymSpell.</summary>
@@ -55,20 +166,16 @@ SymSpell::SymSpell(int initialCapacity, int maxDictionaryEditDistance
 	if (compactLevel > 16) throw std::invalid_argument("compactLevel");
 
 	this->initialCapacity = initialCapacity;
-	this->words.reserve(initialCapacity);
+	this->words.Reserve(initialCapacity);
 	this->maxDictionaryEditDistance = maxDictionaryEditDistance;
 	this->prefixLength = prefixLength;
 	this->countThreshold = countThreshold;
 	if (compactLevel > 16) compactLevel = 16;
 	this->compactMask = (UINT_MAX >> (3 + compactLevel)) << 2;
 	this->maxDictionaryWordLength = 0;
-	this->words = Dictionary<xstring, int64_t>(initialCapacity);
 }
 
 SymSpell::~SymSpell() {
-	if (this->deletes != nullptr) {
-		delete this->deletes;
-	}
 }
 
 /// <summary>Create/Update an entry in the dictionary.</summary>
@@ -83,17 +190,132 @@ SymSpell::~SymSpell() {
 /// existing correctly spelled word.</returns>
 bool SymSpell::CreateDictionaryEntry(xstring key, int64_t count, SuggestionStage* staging)
 {
+	uint32_t id;
+	if (!AddWord(key, count, id))
+	{
+		if (id != UINT32_MAX) RepositionWord(key, id);
+		return false;
+	}
+
+	//edits/suggestions are created only once, no matter how often word occurs
+	//edits/suggestions are created only as soon as the word occurs in the corpus, 
+	//even if the same term existed before in the dictionary as an edit from another word
+	//create deletes
+	PrefixHashes prefixHashes;
+	vector<int> edits;
+	EditHashes(key, prefixHashes, edits);
+	if (staging != NULL)
+	{
+		for (int deleteHash : edits)
+		{
+			staging->Add(deleteHash, id);
+		}
+	}
+	else
+	{
+		// if not staging suggestions, the word is appended to the buckets of its deletes in place
+		for (int deleteHash : edits)
+		{
+			deletes.Add(deleteHash, id, words);
+		}
+	}
 	
+	return true;
+}
+
+/// <summary>Decrease the frequency count of a word, and remove it once it is below the count threshold.</summary>
+/// <remarks>A word that is removed from the correctly spelled words is also removed from the suggestion lists
+/// of its deletes, and kept as a below threshold word with its remaining count, if any. The length of the
+/// longest dictionary word is not reduced. Once removed words are a quarter of the word table, their memory
+/// is reclaimed and the words are numbered again, so words staged in a SuggestionStage must be committed first.</remarks>
+/// <param name="key">The word to decrease the count of.</param>
+/// <param name="count">The amount to decrease the frequency count by.</param>
+/// <returns>True if the word was removed from the correctly spelled words, or false if it remains one,
+/// was a below threshold word, or is not in the dictionary.</returns>
+bool SymSpell::RemoveDictionaryEntry(xstring key, int64_t count)
+{
+	if (count <= 0) throw std::invalid_argument("count");
+	this->generation++;
+	auto belowThresholdWordsFinded = belowThresholdWords.empty() ? belowThresholdWords.end() : belowThresholdWords.find(key);
+	if (belowThresholdWordsFinded != belowThresholdWords.end())
+	{
+		if (belowThresholdWordsFinded->second > count) belowThresholdWordsFinded->second -= count;
+		else belowThresholdWords.erase(belowThresholdWordsFinded);
+		return false;
+	}
+	int64_t wordsFinded = words.Find(key);
+	if (wordsFinded < 0) return false;
+	uint32_t id = (uint32_t)wordsFinded;
+	int64_t remaining = words.Count(id) > count ? words.Count(id) - count : 0;
+	if (remaining > 0 && remaining >= countThreshold)
+	{
+		words.SetCount(id, remaining);
+		RepositionWord(key, id);
+		return false;
+	}
+
+	PrefixHashes prefixHashes;
+	vector<int> edits;
+	EditHashes(key, prefixHashes, edits);
+	for (int deleteHash : edits)
+	{
+		deletes.Remove(deleteHash, id);
+	}
+	words.Remove(id);
+	if (remaining > 0) belowThresholdWords.insert(pair<xstring, int64_t>(key, remaining));
+	// the ids and chars of removed words are reclaimed once they are a quarter of the table, which keeps
+	// the cost of compacting amortized over the removals
+	if (words.RemovedWords() * 4 > words.Size()) CompactWords();
+	return true;
+}
+
+//drop the removed words from the word table, and renumber the word ids in the delete index
+void SymSpell::CompactWords()
+{
+	vector<uint32_t> renumbered = words.Compact();
+	deletes.Renumber(renumbered);
+}
+
+//move a word within the buckets of its deletes after its count changed, so that they stay in order of descending count
+void SymSpell::RepositionWord(xstring_view key, uint32_t id)
+{
+	// an unsorted index is sorted as a whole once the bulk change that left it unsorted is committed
+	if (!deletes.Sorted()) return;
+	PrefixHashes prefixHashes;
+	vector<int> edits;
+	EditHashes(key, prefixHashes, edits);
+	for (int deleteHash : edits)
+	{
+		deletes.Reposition(deleteHash, id, words);
+	}
+}
+
+/// <summary>Remove a word from the dictionary, whatever its frequency count.</summary>
+/// <param name="key">The word to remove.</param>
+/// <returns>True if the word was removed from the correctly spelled words, or false if it
+/// was a below threshold word, or is not in the dictionary.</returns>
+bool SymSpell::RemoveDictionaryEntry(xstring key)
+{
+	return RemoveDictionaryEntry(key, MAXLONG);
+}
+
+//add or update a word and its count, without creating deletes
+//returns true and the id of the word, if it was added as a new correctly spelled word,
+//and false and the id of the word if the count of a correctly spelled word was updated, UINT32_MAX otherwise
+bool SymSpell::AddWord(xstring_view key, int64_t count, uint32_t& id)
+{
+	this->generation++;
+	id = UINT32_MAX;
 	if (count <= 0)
 	{
 		if (this->countThreshold > 0) return false; // no point doing anything if count is zero, as it can't change anything
 		count = 0;
 	}
-	int countPrevious = -1;
+	int64_t countPrevious = -1;
 	// look first in below threshold words, update count, and allow promotion to correct spelling word if count reaches threshold
 	// threshold must be >1 for there to be the possibility of low threshold words
-	auto belowThresholdWordsFinded = belowThresholdWords.find(key);
-	auto wordsFinded = words.find(key);
+	auto belowThresholdWordsFinded = belowThresholdWords.empty() ? belowThresholdWords.end() : belowThresholdWords.find(xstring(key));
+	int64_t wordsFinded = words.Find(key);
 	if (countThreshold > 1 && belowThresholdWordsFinded != belowThresholdWords.end())
 	{
 		countPrevious = belowThresholdWordsFinded->second;
@@ -103,86 +325,36 @@ bool SymSpell::CreateDictionaryEntry(xstring key, int64_t count, SuggestionStage
 		// has reached threshold - remove from below threshold collection (it will be added to correct words below)
 		if (count >= countThreshold)
 		{
-			belowThresholdWords.erase(key);
+			belowThresholdWords.erase(belowThresholdWordsFinded);
 		}
 		else
 		{
-			//belowThresholdWords[key] = count;
-			belowThresholdWords.insert(pair<xstring, int64_t>(key, count));
+			belowThresholdWordsFinded->second = count;
 			return false;
 		}
 	}
-	else if (wordsFinded != words.end())
+	else if (wordsFinded >= 0)
 	{
-		countPrevious = wordsFinded->second;
+		countPrevious = words.Count(wordsFinded);
 		// just update count if it's an already added above threshold word
 		count = (MAXINT - countPrevious > count) ? countPrevious + count : MAXINT;
-		//words[key] = count;
-		words.insert(pair<xstring, int64_t>(key, count));
+		words.SetCount(wordsFinded, count);
+		id = (uint32_t)wordsFinded;
 		return false;
 	}
 	else if (count < CountThreshold())
 	{
 		// new or existing below threshold word
 		//belowThresholdWords[key] = count;
-		belowThresholdWords.insert(pair<xstring, int64_t>(key, count));
+		belowThresholdWords.insert(pair<xstring, int64_t>(xstring(key), count));
 		return false;
 	}
 	
 	// what we have at this point is a new, above threshold word
-	//words[key] = count;
-	words.insert(pair<xstring, int64_t>(key, count));
-	
-	//edits/suggestions are created only once, no matter how often word occurs
-	//edits/suggestions are created only as soon as the word occurs in the corpus, 
-	//even if the same term existed before in the dictionary as an edit from another word
-	if (key.size() > this->maxDictionaryWordLength) this->maxDictionaryWordLength = key.size();
+	id = words.Add(key, count);
 	
-	//create deletes
-	HashSet<xstring> edits = EditsPrefix(key);
-	// if not staging suggestions, put directly into main data structure
-	if (staging != NULL)
-	{
-		/*ofstream outfile;
-		outfile.open("log.txt", ios::app);
-		outfile << words.size() << " " << key <<edits.size();*/
-		for (auto it = edits.begin(); it != edits.end(); ++it)
-		{
-			staging->Add(GetstringHash(*it), key);
-			//outfile << "-" << *it;
-		}
-		/*outfile << endl;
-		outfile.close();*/
-	}
-	else
-	{
-		
-		for (auto it = edits.begin(); it != edits.end(); ++it)
-		{
-			int deleteHash = GetstringHash(*it);
-			auto deletesFinded = deletes->find(deleteHash);
-			std::vector<xstring> suggestions;
-			if(deletesFinded != deletes->end())
-			//if (deletes.TryGetValue(deleteHash, out string[] suggestions))
-			{
-				suggestions = deletesFinded->second;
-				std::vector<xstring> newSuggestions(suggestions.size() + 1);
-				for(int id=0; id<suggestions.size(); id++){
-					newSuggestions[id] = suggestions[id];
-				}
-				
-				(*deletes)[deleteHash] = suggestions = newSuggestions;
-			}
-			else
-			{
-				suggestions = vector<xstring>(1);
-				//(*deletes)[deleteHash] = suggestions;
-				(*deletes).insert(pair<int, vector<xstring>>(deleteHash, suggestions));
-			}
-			suggestions[suggestions.size() - 1] = key;
-		}
-		
-	}
+	int length = CharCount(key);
+	if (length > this->maxDictionaryWordLength) this->maxDictionaryWordLength = length;
 	
 	return true;
 }
@@ -196,6 +368,11 @@ bool SymSpell::CreateDictionaryEntry(xstring key, int64_t count, SuggestionStage
 /// <returns>True if file loaded, or false if file not found.</returns>
 bool SymSpell::LoadBigramDictionary(string corpus, int termIndex, int countIndex, xchar separatorChars)
 {
+#ifndef UNICODE_SUPPORT
+	// parse the file in place, if it can be mapped
+	MappedFile file;
+	if (file.Open(corpus)) return ParseBigramDictionary(xstring_view(file.Data(), file.Size()), termIndex, countIndex, separatorChars);
+#endif
 	xifstream corpusStream;
 	corpusStream.open(corpus);
 #ifdef UNICODE_SUPPORT
@@ -217,42 +394,63 @@ bool SymSpell::LoadBigramDictionary(string corpus, int termIndex, int countIndex
 /// <returns>True if file loaded, or false if file not found.</returns>
 bool SymSpell::LoadBigramDictionary(xifstream& corpusStream, int termIndex, int countIndex, xchar separatorChars)
 {
-	xstring line;
-	int linePartsLength = (separatorChars == DEFAULT_SEPARATOR_CHAR) ? 3 : 2;
-	//process a single line at a time only for memory efficiency
-	while (getline(corpusStream, line))
+	xstringstream content;
+	content << corpusStream.rdbuf();
+	return ParseBigramDictionary(xstring_view(content.str()), termIndex, countIndex, separatorChars);
+}
+
+//parse bigram/frequency count pairs from the content of a bigram dictionary file
+bool SymSpell::ParseBigramDictionary(xstring_view corpus, int termIndex, int countIndex, xchar separatorChars)
+{
+	this->generation++;
+	loadErrors.clear();
+	//if default (whitespace) is defined as separator take 2 term parts, otherwise take only one
+	bool twoTerms = (separatorChars == DEFAULT_SEPARATOR_CHAR);
+	size_t linePartsLength = twoTerms ? 3 : 2;
+	size_t maxIndex = max(countIndex, twoTerms ? termIndex + 1 : termIndex);
+	LineSplitter lines(corpus);
+	vector<xstring_view> lineParts;
+	xstring_view line;
+	xstring key;
+	vector<BigramTable::Bigram> staged;
+	int64_t lineNumber = 0;
+	while (lines.Next(line))
 	{
-		vector<xstring> lineParts;
-		xstringstream ss(line);
-		xstring token;
-		while (getline(ss, token, separatorChars))
-			lineParts.push_back(token);
-		xstring key;
+		lineNumber++;
+		if (line.empty()) continue;
+		LineSplitter::Columns(line, separatorChars, lineParts);
 		int64_t count;
 		if (lineParts.size() >= linePartsLength)
 		{
-			//if default (whitespace) is defined as separator take 2 term parts, otherwise take only one
-			key = (separatorChars == DEFAULT_SEPARATOR_CHAR) ? lineParts[termIndex] + XL(" ") + lineParts[termIndex + 1]: lineParts[termIndex];
-			try{
-				count = stoll(lineParts[countIndex]);
-				
-			}catch(...) {
-				//maybe log something here
-				printf("Cannot convert %s to integer\n", lineParts[countIndex].c_str());
+			if (maxIndex >= lineParts.size() || !Helpers::ParseInt64(lineParts[countIndex], count))
+			{
+				loadErrors.push_back(LoadError(lineNumber, line));
+				continue;
+			}
+			key.assign(lineParts[termIndex]);
+			if (twoTerms)
+			{
+				key += XL(' ');
+				key.append(lineParts[termIndex + 1]);
 			}
 		}
 		else
 		{
-			//if default (whitespace) is defined as separator take 2 term parts, otherwise take only one
-			key = line;
+			key.assign(line);
 			count = 1;
 		}
-		pair<xstring, int64_t> element(key, count);
-		bigrams.insert(element);
+		//LookupCompound looks for "word1 word2", so a bigram is found as any pair of words it consists of,
+		//and one without a space is never found
+		xstring_view bigram(key);
+		for (size_t space = bigram.find(XL(' ')); space != bigram.npos; space = bigram.find(XL(' '), space + 1))
+		{
+			bigrams.Stage(bigram.substr(0, space), bigram.substr(space + 1), count, staged);
+		}
 		if (count < bigramCountMin) bigramCountMin = count;
 	}
+	bigrams.Merge(staged);
 
-	if (bigrams.empty())
+	if (bigrams.Size() == 0)
 		return false;
 	return true;
 }
@@ -266,9 +464,12 @@ bool SymSpell::LoadBigramDictionary(xifstream& corpusStream, int termIndex, int
 /// <returns>True if file loaded, or false if file not found.</returns>
 bool SymSpell::LoadDictionary(string corpus, int termIndex, int countIndex, xchar separatorChars)
 {
-	
+#ifndef UNICODE_SUPPORT
+	// parse the file in place, if it can be mapped
+	MappedFile file;
+	if (file.Open(corpus)) return ParseDictionary(xstring_view(file.Data(), file.Size()), termIndex, countIndex, separatorChars);
+#endif
 	xifstream corpusStream(corpus);
-	/*corpusStream.open(corpus);*/
 #ifdef UNICODE_SUPPORT
 	locale utf8(locale(), new codecvt_utf8<wchar_t>);
 	corpusStream.imbue(utf8);
@@ -288,43 +489,142 @@ bool SymSpell::LoadDictionary(string corpus, int termIndex, int countIndex, xcha
 /// <returns>True if stream loads.</returns>
 bool SymSpell::LoadDictionary(xifstream& corpusStream, int termIndex, int countIndex, xchar separatorChars)
 {
-	SuggestionStage staging(16384);
-	xstring line;
-	int i = 0;
-	int start, end;
-	start = clock();
-	//process a single line at a time only for memory efficiency
-	while (getline(corpusStream, line))
+	xstringstream content;
+	content << corpusStream.rdbuf();
+	return ParseDictionary(xstring_view(content.str()), termIndex, countIndex, separatorChars);
+}
+
+//parse word/frequency count pairs from the content of a dictionary file
+bool SymSpell::ParseDictionary(xstring_view corpus, int termIndex, int countIndex, xchar separatorChars)
+{
+	loadErrors.clear();
+	size_t maxIndex = max(termIndex, countIndex);
+	vector<uint32_t> newWords;
+	uint32_t id;
+	LineSplitter lines(corpus);
+	vector<xstring_view> lineParts;
+	xstring_view line;
+	int64_t lineNumber = 0;
+	while (lines.Next(line))
 	{
-		//end = clock();
-		//cout << float((end - start) * 1000 / CLOCKS_PER_SEC) << " ";
-		i++;
-		vector<xstring> lineParts;
-		xstringstream ss(line);
-		xstring token;
-		//start = clock();
-		while (getline(ss, token, separatorChars))
-			lineParts.push_back(token);
+		lineNumber++;
+		if (line.empty()) continue;
+		LineSplitter::Columns(line, separatorChars, lineParts);
 		if (lineParts.size() >= 2)
 		{
-			int64_t count = stoll(lineParts[countIndex]);
-
-			CreateDictionaryEntry(lineParts[termIndex], count, &staging);
+			int64_t count;
+			if (maxIndex >= lineParts.size() || !Helpers::ParseInt64(lineParts[countIndex], count))
+			{
+				loadErrors.push_back(LoadError(lineNumber, line));
+				continue;
+			}
+			if (AddWord(lineParts[termIndex], count, id)) newWords.push_back(id);
+			else if (id != UINT32_MAX) deletes.CountChanged();
 		}
 		else
 		{
-			CreateDictionaryEntry(line, 1, &staging);
+			if (AddWord(line, 1, id)) newWords.push_back(id);
+			else if (id != UINT32_MAX) deletes.CountChanged();
 		}
-		
 	}
-	if (this->deletes == NULL)
-		this->deletes = new Dictionary<int, vector<xstring>>(staging.DeleteCount());
-	CommitStaged(&staging);
+	CommitDeletes(newWords);
 	if (this->EntryCount() == 0)
 		return false;
 	return true;
 }
 
+/// <summary>Apply a file of dictionary changes, such as the difference between two versions of a dictionary file.</summary>
+/// <remarks>Every line holds an operation, a word and a count, separated by separatorChars:
+/// "+ word count" adds count to the count of the word, as CreateDictionaryEntry,
+/// "= word count" sets the count of the word, adding or removing it as needed,
+/// "- word count" decreases the count of the word, as RemoveDictionaryEntry, and
+/// "- word" removes the word. The changes are made in place, without rebuilding the delete index.
+/// Lines that cannot be parsed are skipped and reported by LoadErrors.</remarks>
+/// <param name="delta">The path+filename of the file.</param>
+/// <param name="stats">Optional counts of the words added, updated and removed.</param>
+/// <param name="separatorChars">Separator characters between operation, word and count.</param>
+/// <returns>True if file loaded, or false if file not found.</returns>
+bool SymSpell::ApplyDelta(string delta, DeltaStats* stats, xchar separatorChars)
+{
+#ifndef UNICODE_SUPPORT
+	MappedFile file;
+	if (file.Open(delta)) return ParseDelta(xstring_view(file.Data(), file.Size()), stats, separatorChars);
+#endif
+	xifstream deltaStream(delta);
+#ifdef UNICODE_SUPPORT
+	locale utf8(locale(), new codecvt_utf8<wchar_t>);
+	deltaStream.imbue(utf8);
+#endif
+	if (!deltaStream.is_open())
+		return false;
+
+	return ApplyDelta(deltaStream, stats, separatorChars);
+}
+
+/// <summary>Apply a stream of dictionary changes, see ApplyDelta(string, DeltaStats*, xchar).</summary>
+/// <param name="deltaStream">The stream containing the changes.</param>
+/// <param name="stats">Optional counts of the words added, updated and removed.</param>
+/// <param name="separatorChars">Separator characters between operation, word and count.</param>
+/// <returns>True if stream loads.</returns>
+bool SymSpell::ApplyDelta(xifstream& deltaStream, DeltaStats* stats, xchar separatorChars)
+{
+	xstringstream content;
+	content << deltaStream.rdbuf();
+	return ParseDelta(xstring_view(content.str()), stats, separatorChars);
+}
+
+//parse and apply the changes of a delta file
+bool SymSpell::ParseDelta(xstring_view delta, DeltaStats* stats, xchar separatorChars)
+{
+	loadErrors.clear();
+	DeltaStats changes;
+	LineSplitter lines(delta);
+	vector<xstring_view> lineParts;
+	xstring_view line;
+	int64_t lineNumber = 0;
+	while (lines.Next(line))
+	{
+		lineNumber++;
+		if (line.empty()) continue;
+		LineSplitter::Columns(line, separatorChars, lineParts);
+		int64_t count = 0;
+		bool valid = (lineParts.size() == 2 || lineParts.size() == 3) && lineParts[0].size() == 1 && !lineParts[1].empty()
+			&& (lineParts.size() == 2 ? lineParts[0][0] == XL('-') : Helpers::ParseInt64(lineParts[2], count) && count >= 0);
+		if (!valid || (lineParts[0][0] != XL('+') && lineParts[0][0] != XL('=') && lineParts[0][0] != XL('-')))
+		{
+			loadErrors.push_back(LoadError(lineNumber, line));
+			continue;
+		}
+		xstring key(lineParts[1]);
+		int64_t previous = CountOf(key);
+		// the change of the count: a set count is reached by adding or removing the difference to the current count
+		int64_t change = count;
+		if (lineParts[0][0] == XL('=')) change = count - previous;
+		else if (lineParts[0][0] == XL('-')) change = lineParts.size() == 2 ? -previous : -count;
+		if (change > 0)
+		{
+			if (CreateDictionaryEntry(key, change, NULL)) changes.added++;
+			else if (CountOf(key) != previous) changes.updated++;
+		}
+		else if (change < 0 && previous > 0)
+		{
+			if (RemoveDictionaryEntry(key, -change)) changes.removed++;
+			else changes.updated++;
+		}
+	}
+	if (stats != NULL) *stats = changes;
+	return true;
+}
+
+//frequency count of a correctly spelled or below threshold word, 0 if the word is unknown
+int64_t SymSpell::CountOf(xstring_view key) const
+{
+	int64_t id = words.Find(key);
+	if (id >= 0) return words.Count((uint32_t)id);
+	auto belowThresholdWordsFinded = belowThresholdWords.empty() ? belowThresholdWords.end() : belowThresholdWords.find(xstring(key));
+	return belowThresholdWordsFinded != belowThresholdWords.end() ? belowThresholdWordsFinded->second : 0;
+}
+
 /// <summary>Load multiple dictionary words from a file containing plain text.</summary>
 /// <remarks>Merges with any dictionary data already loaded.</remarks>
 /// <param name="corpus">The path+filename of the file.</param>
@@ -348,18 +648,22 @@ bool SymSpell::CreateDictionary(string corpus)
 /// <returns>True if stream loads.</returns>
 bool SymSpell::CreateDictionary(xifstream& corpusStream)
 {
+	vector<uint32_t> newWords;
+	uint32_t id;
 	xstring line;
-	SuggestionStage staging = SuggestionStage(16384);
+	xstring_view key;
 	while (getline(corpusStream, line))
 	{
-		for (xstring key : ParseWords(line))
+		WordTokenizer words(line, this->utf8);
+		while (words.Next(key))
 		{
-			CreateDictionaryEntry(key, 1, &staging);
+			if (AddWord(key, 1, id)) newWords.push_back(id);
+			// repeated words change counts in bulk, which are put back in order once by CommitDeletes
+			else if (id != UINT32_MAX) deletes.CountChanged();
 		}
 		
 	}
-	if (this->deletes == NULL) this->deletes = new Dictionary<int, vector<xstring>>(staging.DeleteCount());
-	CommitStaged(&staging);
+	CommitDeletes(newWords);
 	if (this->EntryCount() == 0)
 		return false;
 	return true;
@@ -373,14 +677,195 @@ void SymSpell::PurgeBelowThresholdWords()
 	belowThresholdWords.clear();
 }
 
+/// <summary>Find the words of the dictionary and of the bigrams by minimal perfect hashes, once the dictionary no longer changes.</summary>
+/// <remarks>The hash slots of 8 to 16 bytes per word are replaced by less than a byte per word, while an exact match
+/// takes one hash, a few more memory accesses than with hash slots, and at most one comparison. The words are
+/// numbered in the order of the perfect hash, and removed words are dropped, so suggestions staged before are
+/// to be committed first. Results do not change. The next change of the words goes back to hash slots, so Freeze
+/// again after updates. Frozen tables are kept by SaveSnapshot.</remarks>
+void SymSpell::Freeze()
+{
+	vector<uint32_t> renumbered = words.Freeze();
+	if (!renumbered.empty()) deletes.Renumber(renumbered);
+	bigrams.Freeze();
+}
+
+/// <summary>Save the precomputed dictionary to a binary snapshot file.</summary>
+/// <remarks>The snapshot contains the words, their counts, the delete index and the bigrams,
+/// but not the below threshold words. It can be opened with OpenSnapshot by an instance
+/// with the same maxDictionaryEditDistance, prefixLength, compactLevel and UTF-8 mode.
+/// The file is written to path + ".tmp" and then renamed over path, so a snapshot that is
+/// opened, by this or other instances, can be saved over; its readers keep the old version.</remarks>
+/// <param name="path">The path+filename of the snapshot file.</param>
+/// <returns>True if the snapshot was written.</returns>
+bool SymSpell::SaveSnapshot(string path)
+{
+	// written next to the target and renamed over it, so that the file of a mapped snapshot, of this
+	// or another instance, is never truncated under its readers, and a failed save leaves it intact
+	string temporary = path + ".tmp";
+	ofstream out(temporary, ios::binary | ios::trunc);
+	if (!out.is_open()) return false;
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.byteOrder = SNAPSHOT_BYTE_ORDER;
+	header.charSize = sizeof(xchar);
+	header.maxDictionaryEditDistance = this->maxDictionaryEditDistance;
+	header.prefixLength = this->prefixLength;
+	header.compactMask = this->compactMask;
+	header.maxDictionaryWordLength = this->maxDictionaryWordLength;
+	header.utf8 = this->utf8;
+	header.bigramCountMin = this->bigramCountMin;
+	// the header is rewritten with size and checksum once the payload is known
+	out.write((const char*)&header, sizeof(header));
+
+	SnapshotWriter writer(out);
+	words.Serialize(writer);
+	deletes.Serialize(writer);
+	bigrams.Serialize(writer);
+
+	header.payloadSize = writer.Size();
+	header.checksum = writer.Checksum();
+	out.seekp(0);
+	out.write((const char*)&header, sizeof(header));
+	out.flush();
+	bool written = out.good();
+	out.close();
+	if (!written || out.fail() || !MappedFile::Replace(temporary, path))
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+/// <summary>Replace the dictionary by a binary snapshot file written by SaveSnapshot.</summary>
+/// <remarks>The file is memory mapped read-only and queried in place, without deserialization.
+/// Later dictionary updates copy the affected structures into memory first.</remarks>
+/// <param name="path">The path+filename of the snapshot file.</param>
+/// <returns>True if the snapshot was opened, or false if the file was not found, is corrupted,
+/// or was built with different maxDictionaryEditDistance, prefixLength, compactLevel, character width or UTF-8 mode.</returns>
+bool SymSpell::OpenSnapshot(string path)
+{
+	shared_ptr<MappedFile> file = make_shared<MappedFile>();
+	if (!file->Open(path) || file->Size() < sizeof(SnapshotHeader)) return false;
+
+	SnapshotHeader header;
+	memcpy(&header, file->Data(), sizeof(header));
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != SNAPSHOT_VERSION
+		|| header.byteOrder != SNAPSHOT_BYTE_ORDER
+		|| header.charSize != sizeof(xchar)
+		|| header.utf8 != (int32_t)this->utf8
+		|| header.maxDictionaryEditDistance != this->maxDictionaryEditDistance
+		|| header.prefixLength != this->prefixLength
+		|| header.compactMask != this->compactMask
+		|| header.payloadSize != file->Size() - sizeof(header)
+		|| header.payloadSize % 8 != 0)
+		return false;
+
+	const char* payload = file->Data() + sizeof(header);
+	SnapshotChecksum checksum;
+	checksum.Add(payload, header.payloadSize);
+	if (checksum.Value() != header.checksum) return false;
+
+	// attach to copies first, so that a malformed payload leaves this instance untouched
+	WordTable snapshotWords;
+	DeleteIndex snapshotDeletes;
+	BigramTable snapshotBigrams;
+	SnapshotReader reader(payload, header.payloadSize);
+	snapshotWords.Serialize(reader);
+	snapshotDeletes.Serialize(reader);
+	snapshotBigrams.Serialize(reader);
+	// a payload with a valid checksum may still hold arrays that do not fit together
+	if (!reader.Valid() || !snapshotWords.Validate() || !snapshotDeletes.Validate(snapshotWords) || !snapshotBigrams.Validate()) return false;
+
+	this->words = std::move(snapshotWords);
+	this->deletes = std::move(snapshotDeletes);
+	this->bigrams = std::move(snapshotBigrams);
+	this->belowThresholdWords.clear();
+	this->maxDictionaryWordLength = header.maxDictionaryWordLength;
+	this->bigramCountMin = header.bigramCountMin;
+	this->snapshot = file;
+	this->generation++;
+	return true;
+}
+
 /// <summary>Commit staged dictionary additions.</summary>
 /// <remarks>Used when you write your own process to load multiple words into the
 /// dictionary, and as part of that process, you first created a SuggestionsStage 
-/// object, and passed that to CreateDictionaryEntry calls.</remarks>
+/// object, and passed that to CreateDictionaryEntry calls. The suggestions of every
+/// delete are then ordered by descending count.</remarks>
 /// <param name="staging">The SuggestionStage object storing the staged data.</param>
 void SymSpell::CommitStaged(SuggestionStage* staging)
 {
-	staging->CommitTo(deletes);
+	this->generation++;
+	staging->CommitTo(&deletes);
+	deletes.Sort(words);
+}
+
+//create the deletes of new words on BuildThreads() threads and merge them into the delete index
+//every thread creates the deletes of a contiguous range of words and distributes them to shards by delete hash,
+//then every shard is sorted by delete hash and descending word id, which is the bucket order of a SuggestionStage
+void SymSpell::CommitDeletes(const vector<uint32_t>& newWords)
+{
+	this->generation++;
+	const size_t minWordsPerThread = 1024;
+	int threads = (int)max((size_t)1, min((size_t)BuildThreads(), newWords.size() / minWordsPerThread));
+	int shardCount = threads * 4;
+	auto shardOf = [shardCount](int deleteHash) { return (int)((((uint64_t)(uint32_t)deleteHash * 2654435769u) & 0xFFFFFFFF) * shardCount >> 32); };
+	// parts[thread][shard]
+	vector<vector<vector<pair<int, uint32_t>>>> parts(threads, vector<vector<pair<int, uint32_t>>>(shardCount));
+	vector<thread> workers;
+	for (int t = 0; t < threads; t++)
+	{
+		workers.emplace_back([&, t]()
+		{
+			size_t first = newWords.size() * t / threads, last = newWords.size() * (t + 1) / threads;
+			PrefixHashes prefixHashes;
+			vector<int> edits;
+			for (size_t i = first; i < last; i++)
+			{
+				uint32_t id = newWords[i];
+				EditHashes(words.Term(id), prefixHashes, edits);
+				for (int deleteHash : edits)
+				{
+					parts[t][shardOf(deleteHash)].push_back(pair<int, uint32_t>(deleteHash, id));
+				}
+			}
+		});
+	}
+	for (thread& worker : workers) worker.join();
+	workers.clear();
+
+	vector<vector<pair<int, uint32_t>>> shards(shardCount);
+	for (int t = 0; t < threads; t++)
+	{
+		workers.emplace_back([&, t]()
+		{
+			for (int s = t; s < shardCount; s += threads)
+			{
+				size_t size = 0;
+				for (int p = 0; p < threads; p++) size += parts[p][s].size();
+				shards[s].reserve(size);
+				for (int p = 0; p < threads; p++)
+				{
+					shards[s].insert(shards[s].end(), parts[p][s].begin(), parts[p][s].end());
+					vector<pair<int, uint32_t>>().swap(parts[p][s]);
+				}
+				sort(shards[s].begin(), shards[s].end(), [](const pair<int, uint32_t>& l, const pair<int, uint32_t>& r)
+				{
+					return (l.first != r.first) ? l.first < r.first : l.second > r.second;
+				});
+			}
+		});
+	}
+	for (thread& worker : workers) worker.join();
+
+	deletes.Merge(shards);
+	deletes.Sort(words);
 }
 
 /// <summary>Find suggested spellings for a given input word, using the maximum
@@ -389,7 +874,7 @@ void SymSpell::CommitStaged(SuggestionStage* staging)
 /// <param name="verbosity">The value controlling the quantity/closeness of the retuned suggestions.</param>
 /// <returns>A vector of SuggestItem object representing suggested correct spellings for the input word, 
 /// sorted by edit distance, and secondarily by count frequency.</returns>
-vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity)
+vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity) const
 {
 	return Lookup(input, verbosity, this->maxDictionaryEditDistance, false);
 }
@@ -401,7 +886,7 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity)
 /// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
 /// <returns>A vector of SuggestItem object representing suggested correct spellings for the input word, 
 /// sorted by edit distance, and secondarily by count frequency.</returns>
-vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int maxEditDistance)
+vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int maxEditDistance) const
 {
 	return Lookup(input, verbosity, maxEditDistance, false);
 }
@@ -413,8 +898,234 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 /// <param name="includeUnknown">Include input word in suggestions, if no words within edit distance found.</param>																													   
 /// <returns>A vector of SuggestItem object representing suggested correct spellings for the input word, 
 /// sorted by edit distance, and secondarily by count frequency.</returns>
-vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int maxEditDistance, bool includeUnknown)
+vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int maxEditDistance, bool includeUnknown) const
 {
+	static thread_local LookupContext context;
+	vector<SuggestItem> suggestions;
+	Lookup(input, verbosity, maxEditDistance, includeUnknown, context, suggestions);
+	return suggestions;
+}
+
+//the candidates of a lookup (input prefix and its deletes), stored back to back in the order they are processed
+//the generic engine keeps them in the buffers of the context, reserved for the largest possible number of candidates
+//candidates are chars, or code points in UTF-8 mode
+template <class Engine, class Char, bool Fixed = (Engine::prefixLength > 0)>
+class CandidateBuffer
+{
+private:
+	vector<Char>& chars;
+	vector<uint32_t>& starts;
+	vector<int>& hashes;
+	// deletes we've considered already (by candidate index)
+	ScratchSet& considered;
+
+public:
+	CandidateBuffer(vector<Char>& chars, vector<uint32_t>& starts, vector<int>& hashes, ScratchSet& considered)
+		: chars(chars), starts(starts), hashes(hashes), considered(considered) {}
+
+	//start with the input prefix, which has deletes of up to maxEditDistance chars
+	void Start(basic_string_view<Char> prefix, int hash, int maxEditDistance)
+	{
+		considered.Clear();
+		chars.clear();
+		starts.assign(1, 0);
+		hashes.clear();
+		//reserving room for all deletes keeps views of the candidates valid while deletes are appended
+		size_t candidateCount = 0, charCount = 0, combinations = 1;
+		int len = prefix.size();
+		for (int d = 0; d <= maxEditDistance && d <= len; d++)
+		{
+			candidateCount += combinations;
+			charCount += combinations * (len - d);
+			combinations = combinations * (len - d) / (d + 1);
+		}
+		chars.reserve(charCount);
+		starts.reserve(candidateCount + 1);
+		hashes.reserve(candidateCount);
+		chars.insert(chars.end(), prefix.begin(), prefix.end());
+		starts.push_back((uint32_t)chars.size());
+		hashes.push_back(hash);
+	}
+
+	size_t Size() const { return hashes.size(); }
+	int Hash(size_t index) const { return hashes[index]; }
+	basic_string_view<Char> Candidate(size_t index) const { return basic_string_view<Char>(chars.data() + starts[index], starts[index + 1] - starts[index]); }
+
+	//add the candidate without the char at index, unless it was added already
+	void AddDelete(basic_string_view<Char> candidate, int index, int hash)
+	{
+		// the delete is compared as the candidate parts before and after index, and only copied if it is new
+		basic_string_view<Char> head = candidate.substr(0, index), tail = candidate.substr(index + 1);
+		auto equal = [&](uint32_t other)
+		{
+			basic_string_view<Char> considered = Candidate(other);
+			return considered.size() == head.size() + tail.size()
+				&& considered.compare(0, head.size(), head) == 0 && considered.compare(head.size(), tail.size(), tail) == 0;
+		};
+		if (considered.Insert((uint32_t)hash, (uint32_t)hashes.size(), equal))
+		{
+			chars.insert(chars.end(), head.begin(), head.end());
+			chars.insert(chars.end(), tail.begin(), tail.end());
+			starts.push_back((uint32_t)chars.size());
+			hashes.push_back(hash);
+		}
+	}
+};
+
+//an engine with a fixed prefix length and maximum edit distance keeps the candidates in arrays of their largest possible size
+template <class Engine, class Char>
+class CandidateBuffer<Engine, Char, true>
+{
+private:
+	static const size_t maxCandidates = Engine::MaxCandidates();
+	Char chars[Engine::MaxCandidateChars() + 1];
+	uint32_t starts[maxCandidates + 1];
+	int hashes[maxCandidates];
+	size_t count = 0;
+	// first candidate of the length of the deletes being added, as candidates are ordered by length
+	size_t sameLength = 0;
+
+public:
+	CandidateBuffer(vector<Char>&, vector<uint32_t>&, vector<int>&, ScratchSet&) {}
+
+	void Start(basic_string_view<Char> prefix, int hash, int)
+	{
+		std::copy(prefix.begin(), prefix.end(), chars);
+		starts[0] = 0;
+		starts[1] = (uint32_t)prefix.size();
+		hashes[0] = hash;
+		count = 1;
+		sameLength = 1;
+	}
+
+	size_t Size() const { return count; }
+	int Hash(size_t index) const { return hashes[index]; }
+	basic_string_view<Char> Candidate(size_t index) const { return basic_string_view<Char>(chars + starts[index], starts[index + 1] - starts[index]); }
+
+	//add the candidate without the char at index, unless it was added already
+	void AddDelete(basic_string_view<Char> candidate, int index, int hash)
+	{
+		int len = (int)candidate.size() - 1;
+		if ((int)(starts[count] - starts[count - 1]) != len) sameLength = count;
+		// an equal delete has the same length, and there are few of them, so they are compared one by one
+		for (size_t other = sameLength; other < count; other++)
+		{
+			if (hashes[other] != hash) continue;
+			const Char* considered = chars + starts[other];
+			if (std::equal(candidate.begin(), candidate.begin() + index, considered)
+				&& std::equal(candidate.begin() + index + 1, candidate.end(), considered + index)) return;
+		}
+		Char* end = std::copy(candidate.begin(), candidate.begin() + index, chars + starts[count]);
+		end = std::copy(candidate.begin() + index + 1, candidate.end(), end);
+		starts[count + 1] = (uint32_t)(end - chars);
+		hashes[count++] = hash;
+	}
+};
+
+//check whether all delete chars are present in the suggestion prefix in correct order, otherwise this is just a hash collision
+template <class Engine, class Char>
+bool SymSpell::DeleteInSuggestionPrefix(basic_string_view<Char> deleteSugg, int deleteLen, basic_string_view<Char> suggestion, int suggestionLen) const
+{
+	const int prefixLength = Engine::prefixLength > 0 ? Engine::prefixLength : this->prefixLength;
+	if (deleteLen == 0) return true;
+	if (prefixLength < suggestionLen) suggestionLen = prefixLength;
+	int j = 0;
+	for (int i = 0; i < deleteLen; i++)
+	{
+		Char delChar = deleteSugg[i];
+		while (j < suggestionLen && delChar != suggestion[j]) j++;
+		if (j == suggestionLen) return false;
+	}
+	return true;
+}
+
+//number of chars of a text, or of code points in UTF-8 mode
+int SymSpell::CharCount(xstring_view text) const
+{
+#ifndef UNICODE_SUPPORT
+	if (this->utf8) return Utf8::Length(text);
+#endif
+	return (int)text.size();
+}
+
+//start offsets of the chars of a text, or of its code points in UTF-8 mode, followed by the length of the text
+void SymSpell::CharOffsets(xstring_view text, vector<int>& offsets) const
+{
+#ifndef UNICODE_SUPPORT
+	if (this->utf8)
+	{
+		Utf8::Offsets(text, offsets);
+		return;
+	}
+#endif
+	offsets.resize(text.size() + 1);
+	for (size_t i = 0; i <= text.size(); i++) offsets[i] = (int)i;
+}
+
+//edit distance of two texts, of their code points in UTF-8 mode
+int SymSpell::Compare(EditDistance& distance, xstring_view string1, xstring_view string2, int maxDistance) const
+{
+#ifndef UNICODE_SUPPORT
+	if (this->utf8 && !(Utf8::IsAscii(string1) && Utf8::IsAscii(string2)))
+	{
+		u32string codePoints1, codePoints2;
+		Utf8::Decode(string1, codePoints1);
+		Utf8::Decode(string2, codePoints2);
+		return distance.Compare(u32string_view(codePoints1), u32string_view(codePoints2), maxDistance);
+	}
+#endif
+	return distance.Compare(string1, string2, maxDistance);
+}
+
+/// <summary>Find suggested spellings for a given input word, reusing the buffers of a context.</summary>
+/// <param name="input">The word being spell checked.</param>
+/// <param name="verbosity">The value controlling the quantity/closeness of the retuned suggestions.</param>
+/// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
+/// <param name="includeUnknown">Include input word in suggestions, if no words within edit distance found.</param>
+/// <param name="context">Scratch state, used by only one thread at a time.</param>
+/// <param name="suggestions">Receives the SuggestItem objects representing suggested correct spellings for the input word, 
+/// sorted by edit distance, and secondarily by count frequency. Existing items are reused.</param>
+void SymSpell::Lookup(xstring_view input, Verbosity verbosity, int maxEditDistance, bool includeUnknown, LookupContext& context, vector<SuggestItem>& suggestions) const
+{
+	context.stats.Clear();
+	StatsRecorder recorder(this->stats.get(), LookupQuery, context.stats);
+	PhaseTimer timer(context.stats, LookupTime);
+	LookupCacheKey key = { LookupCacheKey::Lookup, input, verbosity, maxEditDistance, includeUnknown };
+	if (this->cache && this->cache->Get(key, this->generation, suggestions))
+	{
+		context.stats.Count(CacheHits);
+		return;
+	}
+
+#ifndef UNICODE_SUPPORT
+	// ASCII input is looked up as chars even in UTF-8 mode, other input as code points
+	if (this->utf8 && !Utf8::IsAscii(input))
+	{
+		Utf8::Decode(input, context.inputCodePoints);
+		LookupChars(input, u32string_view(context.inputCodePoints), verbosity, maxEditDistance, includeUnknown, context, suggestions);
+	}
+	else
+#endif
+		LookupChars(input, input, verbosity, maxEditDistance, includeUnknown, context, suggestions);
+
+	if (this->cache) this->cache->Put(key, this->generation, suggestions);
+}
+
+template <class Char>
+void SymSpell::LookupChars(xstring_view input, basic_string_view<Char> chars, Verbosity verbosity, int maxEditDistance, bool includeUnknown, LookupContext& context, vector<SuggestItem>& suggestions) const
+{
+	if (this->specializedLookup && SymSpellEngine<1, 5>::Matches(this->maxDictionaryEditDistance, this->prefixLength))
+		LookupWith<SymSpellEngine<1, 5>>(input, chars, verbosity, maxEditDistance, includeUnknown, context, suggestions);
+	else if (this->specializedLookup && SymSpellEngine<2, 7>::Matches(this->maxDictionaryEditDistance, this->prefixLength))
+		LookupWith<SymSpellEngine<2, 7>>(input, chars, verbosity, maxEditDistance, includeUnknown, context, suggestions);
+	else
+		LookupWith<SymSpellEngine<0, 0>>(input, chars, verbosity, maxEditDistance, includeUnknown, context, suggestions);
+}
+
+template <class Engine, class Char>
+void SymSpell::LookupWith(xstring_view input, basic_string_view<Char> chars, Verbosity verbosity, int maxEditDistance, bool includeUnknown, LookupContext& context, vector<SuggestItem>& suggestions) const
+{
+	const int prefixLength = Engine::prefixLength > 0 ? Engine::prefixLength : this->prefixLength;
 	//verbosity=Top: the suggestion with the highest term frequency of the suggestions of smallest edit distance found
 	//verbosity=Closest: all suggestions of smallest edit distance found, the suggestions are ordered by term frequency 
 	//verbosity=All: all suggestions <= maxEditDistance, the suggestions are ordered by edit distance, then by term frequency (slower, no early termination)
@@ -424,19 +1135,26 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 	int skip = 0;
 	if (maxEditDistance > this->maxDictionaryEditDistance) throw std::invalid_argument("maxEditDistance");
 
-	vector<SuggestItem> suggestions;
-	int inputLen = input.size();
+	// suggestions are collected as word ids, and only copied into the output once sorted
+	vector<LookupContext::Match>& matches = context.matches;
+	matches.clear();
+	int inputLen = chars.size();
 	// early exit - word is too big to possibly match any words
 	if (inputLen - maxEditDistance > this->maxDictionaryWordLength) skip = 1;
 
 	// quick look for exact match
 	int64_t suggestionCount = 0;
-	if (words.count(input) && !skip)
+	int64_t inputId = skip ? -1 : words.Find(input);
+	if (inputId >= 0)
 	{
-		suggestionCount = words.at(input);
-		suggestions.push_back(SuggestItem(input, 0, suggestionCount));
+		suggestionCount = words.Count(inputId);
+		matches.push_back({ (uint32_t)inputId, 0, suggestionCount });
 		// early exit - return exact match, unless caller wants all matches
-		if (verbosity != All) skip = 1;
+		if (verbosity != All)
+		{
+			skip = 1;
+			context.stats.Count(EarlyTerminations);
+		}
 	}
 
 	//early termination, if we only want to check if word in dictionary or get its frequency e.g. for word segmentation
@@ -444,33 +1162,31 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 
 	if (!skip)
 	{
-		// deletes we've considered already
-		HashSet<xstring> hashset1;
-		// suggestions we've considered already
-		HashSet<xstring> hashset2;
-		// we considered the input already in the word.TryGetValue above		
-		hashset2.insert(input);
+		// suggestions we've considered already (by word id)
+		ScratchSet& hashset2 = context.consideredSuggestions;
+		hashset2.Clear();
+		// we considered the input already in the words.Find above		
+		if (inputId >= 0) hashset2.Insert((uint32_t)inputId);
 
 		int maxEditDistance2 = maxEditDistance;
-		int candidatePointer = 0;
-		vector<xstring> singleSuggestion = { XL("") };
-		vector<xstring> candidates;
+		size_t candidatePointer = 0;
+		CandidateBuffer<Engine, Char> candidates(context.CandidateChars<Char>(), context.candidateStarts, context.candidateHashes, context.consideredDeletes);
+		// candidates are verified against the match masks of the input, which are built on first use
+		bool transpositions = (this->distanceAlgorithm == DistanceAlgorithm::DamerauOSADistance);
+		bool inputPatternSet = false;
+		// in UTF-8 mode, an ASCII input is widened to code points once a suggestion is not ASCII
+		bool inputWidened = false;
+		// buckets ordered by descending count let Top stop scanning a bucket once nothing left in it can beat the best suggestion
+		bool sortedBuckets = verbosity == Top && deletes.Sorted();
 
 		//add original prefix
-		int inputPrefixLen = inputLen;
-		if (inputPrefixLen > prefixLength)
-		{
-			inputPrefixLen = prefixLength;
-			candidates.push_back(input.substr(0, inputPrefixLen));
-		}
-		else
-		{
-			candidates.push_back(input);
-		}
-		auto distanceComparer = EditDistance(this->distanceAlgorithm);
-		while (candidatePointer < candidates.size())
+		int inputPrefixLen = min(inputLen, prefixLength);
+		candidates.Start(chars.substr(0, inputPrefixLen), GetstringHash(chars.substr(0, inputPrefixLen)), maxEditDistance);
+
+		while (candidatePointer < candidates.Size())
 		{
-			xstring candidate = candidates[candidatePointer++];
+			int candidateHash = candidates.Hash(candidatePointer);
+			basic_string_view<Char> candidate = candidates.Candidate(candidatePointer++);
 			int candidateLen = candidate.size();
 			int lengthDiff = inputPrefixLen - candidateLen;
 
@@ -481,25 +1197,38 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 				// skip to next candidate if Verbosity.All, look no further if Verbosity.Top or Closest 
 				// (candidates are ordered by delete distance, so none are closer than current)
 				if (verbosity == Verbosity::All) continue;
+				context.stats.Count(EarlyTerminations);
 				break;
 			}
 
 			//read candidate entry from dictionary
-			if (deletes != nullptr and deletes->count(GetstringHash(candidate)))
+			DeleteIndex::Bucket dictSuggestions = deletes.Find(candidateHash);
+			context.stats.Count(DeleteProbes);
+			if (!dictSuggestions.empty())
 			{
-				vector<xstring> dictSuggestions = deletes->at(GetstringHash(candidate));
-				//iterate through suggestions (to other correct dictionary items) of delete item and add them to suggestion list
-				for (int i = 0; i < dictSuggestions.size(); i++)
+				context.stats.Count(DeleteHits);
+				context.stats.Count(BucketEntries, dictSuggestions.size());
+				//verify a suggestion of the delete item, as chars or code points of the same type as input and candidate
+				auto consider = [&](auto input, auto candidate, auto suggestion, uint32_t suggestionId)
 				{
-					auto suggestion = dictSuggestions[i];
 					int suggestionLen = suggestion.size();
-					if (suggestion == input) continue;
-					if ((abs(suggestionLen - inputLen) > maxEditDistance2) // input and sugg lengths diff > allowed/current best distance
-						|| (suggestionLen < candidateLen) // sugg must be for a different delete string, in same bin only because of hash collision
+					if (abs(suggestionLen - inputLen) > maxEditDistance2) // input and sugg lengths diff > allowed/current best distance
+					{
+						context.stats.Count(LengthRejections);
+						return;
+					}
+					if ((suggestionLen < candidateLen) // sugg must be for a different delete string, in same bin only because of hash collision
 						|| (suggestionLen == candidateLen && suggestion != candidate)) // if sugg len = delete len, then it either equals delete or is in same bin only because of hash collision
-						continue;
+					{
+						context.stats.Count(CollisionRejections);
+						return;
+					}
 					auto suggPrefixLen = min(suggestionLen, prefixLength);
-					if (suggPrefixLen > inputPrefixLen && (suggPrefixLen - candidateLen) > maxEditDistance2) continue;
+					if (suggPrefixLen > inputPrefixLen && (suggPrefixLen - candidateLen) > maxEditDistance2)
+					{
+						context.stats.Count(PrefixRejections);
+						return;
+					}
 
 					//True Damerau-Levenshtein Edit Distance: adjust distance, if both distances>0
 					//We allow simultaneous edits (deletes) of maxEditDistance on on both the dictionary and the input term. 
@@ -514,8 +1243,9 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 					{
 						//suggestions which have no common chars with input (inputLen<=maxEditDistance && suggestionLen<=maxEditDistance)
 						distance = max(inputLen, suggestionLen);
-						auto flag = hashset2.insert(suggestion);
-						if (distance > maxEditDistance2 || !flag.second) continue;
+						bool added = hashset2.Insert(suggestionId);
+						if (!added) context.stats.Count(DuplicateRejections);
+						if (distance > maxEditDistance2 || !added) return;
 					}
 					else if (suggestionLen == 1)
 					{
@@ -525,8 +1255,9 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 						else 
 							distance = inputLen - 1;
 
-						auto flag = hashset2.insert(suggestion);
-						if (distance > maxEditDistance2 || !flag.second) continue;
+						bool added = hashset2.Insert(suggestionId);
+						if (!added) context.stats.Count(DuplicateRejections);
+						if (distance > maxEditDistance2 || !added) return;
 					}
 					else
 						//number of edits in prefix ==maxediddistance  AND no identic suffix
@@ -539,47 +1270,102 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 								&& ((input[inputLen - min_len - 1] != suggestion[suggestionLen - min_len])
 									|| (input[inputLen - min_len] != suggestion[suggestionLen - min_len - 1]))))
 						{
-							continue;
+							context.stats.Count(SuffixRejections);
+							return;
 						}
 						else
 						{
 							// DeleteInSuggestionPrefix is somewhat expensive, and only pays off when verbosity is Top or Closest.
-							if ((verbosity != All && !DeleteInSuggestionPrefix(candidate, candidateLen, suggestion, suggestionLen))
-								|| !hashset2.insert(suggestion).second) continue;
-							distance = distanceComparer.Compare(input, suggestion, maxEditDistance2);
-							if (distance < 0) continue;
+							if (verbosity != All)
+							{
+								context.stats.Count(DeleteInPrefixCalls);
+								if (!DeleteInSuggestionPrefix<Engine>(candidate, candidateLen, suggestion, suggestionLen))
+								{
+									context.stats.Count(DeleteInPrefixRejections);
+									return;
+								}
+							}
+							if (!hashset2.Insert(suggestionId))
+							{
+								context.stats.Count(DuplicateRejections);
+								return;
+							}
+							if (!inputPatternSet)
+							{
+								context.inputPattern.SetPattern(input);
+								inputPatternSet = true;
+							}
+							context.stats.Count(DistanceCalls);
+							distance = context.inputPattern.Distance(suggestion, transpositions, maxEditDistance2);
+							if (distance < 0)
+							{
+								context.stats.Count(DistanceRejections);
+								return;
+							}
 						}
 
 					//save some time
 					//do not process higher distances than those already found, if verbosity<All (note: maxEditDistance2 will always equal maxEditDistance when Verbosity.All)
 					if (distance <= maxEditDistance2)
 					{
-						suggestionCount = words[suggestion];
-						SuggestItem si = SuggestItem(suggestion, distance, suggestionCount);
-						if (suggestions.size() > 0)
+						suggestionCount = words.Count(suggestionId);
+						if (matches.size() > 0)
 						{
 							switch (verbosity)
 							{
 							case Closest:
 							{
 								//we will calculate DamLev distance only to the smallest found distance so far
-								if (distance < maxEditDistance2) suggestions.clear();
+								if (distance < maxEditDistance2) matches.clear();
 								break;
 							}
 							case Top:
 							{
-								if (distance < maxEditDistance2 || suggestionCount > suggestions[0].count)
+								if (distance < maxEditDistance2 || suggestionCount > matches[0].count)
 								{
 									maxEditDistance2 = distance;
-									suggestions[0] = si;
+									matches[0] = { suggestionId, distance, suggestionCount };
 								}
-								continue;
+								return;
 							}
 							}
 						}
 						if (verbosity != All) maxEditDistance2 = distance;
-						suggestions.push_back(si);
+						matches.push_back({ suggestionId, distance, suggestionCount });
 					}
+				};
+
+				//iterate through suggestions (to other correct dictionary items) of delete item and add them to suggestion list
+				for (uint32_t suggestionId : dictSuggestions)
+				{
+					//a Top suggestion at distance 1 is only replaced by one with a larger count, and no later entry has one
+					if (sortedBuckets && maxEditDistance2 == 1 && !matches.empty() && words.Count(suggestionId) <= matches[0].count)
+					{
+						context.stats.Count(BucketCutoffs);
+						break;
+					}
+					xstring_view suggestion = words.Term(suggestionId);
+					if (suggestion == input) continue;
+#ifndef UNICODE_SUPPORT
+					if constexpr (!is_same<Char, xchar>::value)
+					{
+						Utf8::Decode(suggestion, context.suggestionCodePoints);
+						consider(chars, candidate, u32string_view(context.suggestionCodePoints), suggestionId);
+					}
+					else if (this->utf8 && !Utf8::IsAscii(suggestion))
+					{
+						if (!inputWidened)
+						{
+							context.inputCodePoints.assign(chars.begin(), chars.end());
+							inputWidened = true;
+						}
+						context.candidateCopy.assign(candidate.begin(), candidate.end());
+						Utf8::Decode(suggestion, context.suggestionCodePoints);
+						consider(u32string_view(context.inputCodePoints), u32string_view(context.candidateCopy), u32string_view(context.suggestionCodePoints), suggestionId);
+					}
+					else
+#endif
+						consider(chars, candidate, suggestion, suggestionId);
 				}//end foreach
 			}//end if         
 
@@ -590,117 +1376,206 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 			{
 				//save some time
 				//do not create edits with edit distance smaller than suggestions already found
-				if (verbosity != All && lengthDiff >= maxEditDistance2) continue;
+				if (verbosity != All && lengthDiff >= maxEditDistance2)
+				{
+					context.stats.Count(PrunedExpansions);
+					continue;
+				}
 
+				context.candidatePrefixes.Assign(candidate);
 				for (int i = 0; i < candidateLen; i++)
 				{
-					xstring temp(candidate);
-					xstring del = temp.erase(i, 1);
-
-					if (hashset1.insert(del).second) { candidates.push_back(del); }
+					candidates.AddDelete(candidate, i, GetHash(context.candidatePrefixes.Delete(i), candidateLen - 1));
 				}
 			}
 		}//end while
+		context.stats.Count(Candidates, candidates.Size());
 
 		//sort by ascending edit distance, then by descending word frequency
-		if (suggestions.size() > 1) sort(suggestions.begin(), suggestions.end(), [](SuggestItem& l, SuggestItem& r){
-			return l.CompareTo(r) < 0? 1 : 0;
+		if (matches.size() > 1) sort(matches.begin(), matches.end(), [this](const LookupContext::Match& l, const LookupContext::Match& r) {
+			if (l.distance != r.distance) return l.distance < r.distance;
+			if (l.count != r.count) return l.count > r.count;
+			return words.Term(l.id) < words.Term(r.id);
 		});
 	}
-	if (includeUnknown && (suggestions.size() == 0)) suggestions.push_back(SuggestItem(input, maxEditDistance + 1, 0));
-	return suggestions;
+
+	suggestions.resize(matches.size());
+	for (size_t i = 0; i < matches.size(); i++)
+	{
+		suggestions[i].term.assign(words.Term(matches[i].id));
+		suggestions[i].distance = matches[i].distance;
+		suggestions[i].count = matches[i].count;
+	}
+	if (includeUnknown && (suggestions.size() == 0))
+	{
+		suggestions.resize(1);
+		suggestions[0].term.assign(input);
+		suggestions[0].distance = maxEditDistance + 1;
+		suggestions[0].count = 0;
+	}
 }//end if         
 
-	//check whether all delete chars are present in the suggestion prefix in correct order, otherwise this is just a hash collision
-	bool SymSpell::DeleteInSuggestionPrefix(xstring deleteSugg, int deleteLen, xstring suggestion, int suggestionLen)
+//call process(input, result, thread) once for every distinct input on a work stealing pool,
+//then copy the results of repeated inputs
+template <class Result, class Process>
+static void RunBatch(WorkStealingPool& pool, const vector<xstring_view>& inputs, vector<Result>& results, Process process)
+{
+	results.resize(inputs.size());
+
+	// first occurrence of every input, or the index itself for distinct inputs
+	vector<uint32_t> firsts(inputs.size());
+	vector<uint32_t> distinct;
+	distinct.reserve(inputs.size());
 	{
-		if (deleteLen == 0) return true;
-		if (prefixLength < suggestionLen) suggestionLen = prefixLength;
-		int j = 0;
-		for (int i = 0; i < deleteLen; i++)
+		Dictionary<xstring_view, uint32_t> seen;
+		seen.reserve(inputs.size());
+		for (size_t i = 0; i < inputs.size(); i++)
 		{
-			xchar delChar = deleteSugg[i];
-			while (j < suggestionLen && delChar != suggestion[j]) j++;
-			if (j == suggestionLen) return false;
+			auto inserted = seen.insert(pair<xstring_view, uint32_t>(inputs[i], (uint32_t)i));
+			firsts[i] = inserted.first->second;
+			if (inserted.second) distinct.push_back((uint32_t)i);
 		}
-		return true;
 	}
 
+	const size_t grain = 16;
+	pool.For(distinct.size(), grain, [&](size_t i, int t) { process(inputs[distinct[i]], results[distinct[i]], t); });
+	if (distinct.size() < inputs.size())
+	{
+		pool.For(inputs.size(), grain * 16, [&](size_t i, int) { if (firsts[i] != i) results[i] = results[firsts[i]]; });
+	}
+}
+
+/// <summary>Find suggested spellings for many input words on multiple threads.</summary>
+/// <param name="inputs">The words being spell checked.</param>
+/// <param name="verbosity">The value controlling the quantity/closeness of the retuned suggestions.</param>
+/// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
+/// <param name="threads">The number of threads, 0 = one per hardware thread.</param>
+/// <param name="results">Receives the suggestions for every input word, in input order, as returned by Lookup.</param>
+void SymSpell::LookupBatch(const vector<xstring_view>& inputs, Verbosity verbosity, int maxEditDistance, int threads, vector<vector<SuggestItem>>& results) const
+{
+	if (maxEditDistance > this->maxDictionaryEditDistance) throw std::invalid_argument("maxEditDistance");
+	WorkStealingPool pool(threads);
+	vector<LookupContext> contexts(pool.Threads());
+	RunBatch(pool, inputs, results, [&](xstring_view input, vector<SuggestItem>& suggestions, int t)
+	{
+		Lookup(input, verbosity, maxEditDistance, false, contexts[t], suggestions);
+	});
+}
+
+/// <summary>Find suggested spellings for many multi-word input strings on multiple threads.</summary>
+/// <param name="inputs">The strings being spell checked.</param>
+/// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
+/// <param name="threads">The number of threads, 0 = one per hardware thread.</param>
+/// <param name="results">Receives the suggestions for every input string, in input order, as returned by LookupCompound.</param>
+void SymSpell::LookupCompoundBatch(const vector<xstring_view>& inputs, int editDistanceMax, int threads, vector<vector<SuggestItem>>& results) const
+{
+	if (editDistanceMax > this->maxDictionaryEditDistance) throw std::invalid_argument("maxEditDistance");
+	WorkStealingPool pool(threads);
+	RunBatch(pool, inputs, results, [&](xstring_view input, vector<SuggestItem>& suggestions, int)
+	{
+		suggestions = LookupCompound(xstring(input), editDistanceMax);
+	});
+}
+
+/// <summary>Segment many strings into words on multiple threads.</summary>
+/// <param name="inputs">The strings being segmented.</param>
+/// <param name="maxEditDistance">The maximum edit distance between input and corrected words 
+/// (0=no correction/segmentation only).</param>	
+/// <param name="threads">The number of threads, 0 = one per hardware thread.</param>
+/// <param name="results">Receives the segmentation of every input string, in input order, as returned by WordSegmentation.</param>
+void SymSpell::WordSegmentationBatch(const vector<xstring_view>& inputs, int maxEditDistance, int threads, vector<Info>& results) const
+{
+	if (maxEditDistance > this->maxDictionaryEditDistance) throw std::invalid_argument("maxEditDistance");
+	WorkStealingPool pool(threads);
+	RunBatch(pool, inputs, results, [&](xstring_view input, Info& info, int)
+	{
+		info = WordSegmentation(xstring(input), maxEditDistance);
+	});
+}
+
 	//create a non-unique wordlist from sample text
 	//language independent (e.g. works with Chinese characters)
-	vector<xstring> SymSpell::ParseWords(xstring text)
+	vector<xstring_view> SymSpell::ParseWords(xstring_view text) const
 	{
+		// the matches of the regex ['’\w\-\[_\]]+, found by a table driven scan instead
 		// \w Alphanumeric characters (including non-latin characters, umlaut characters and digits) plus "_" 
-		// \d Digits
 		// Compatible with non-latin characters, does not split words at apostrophes
-		xregex r(XL("['’\\w\\-\\[_\\]]+"));
-		xsmatch m;
-		vector<xstring> matches;
-			//for benchmarking only: with CreateDictionary("big.txt","") and the text corpus from http://norvig.com/big.txt  the Regex below provides the exact same number of dictionary items as Norvigs regex "[a-z]+" (which splits words at apostrophes & incompatible with non-latin characters)     
-			//MatchCollection mc = Regex.Matches(text.ToLower(), @"[\w-[\d_]]+");
-		xstring::const_iterator ptr(text.cbegin());
-		while(regex_search(ptr, text.cend(),m,r))
-		{
-			matches.push_back(m[0]);
-			ptr = m.suffix().first;
-		}
+		// the words are views into text
+		vector<xstring_view> matches;
+		WordTokenizer::Words(text, matches, this->utf8);
 		return matches;
 	}
 
 	//inexpensive and language independent: only deletes, no transposes + replaces + inserts
 	//replaces and inserts are expensive and language dependent (Chinese has 70,000 Unicode Han characters)
-	HashSet<xstring>* SymSpell::Edits(xstring word, int editDistance, HashSet<xstring>* deleteWords)
+	//the hashes of the deletes are derived from the prefix hashes of the key, without building the deletes
+	void SymSpell::EditHashes(xstring_view key, PrefixHashes& prefixHashes, vector<int>& editHashes) const
 	{
-		editDistance++;
-		if (word.size() > 1)
+#ifndef UNICODE_SUPPORT
+		// in UTF-8 mode the deletes of words that are not ASCII are those of their code points
+		if (this->utf8 && !Utf8::IsAscii(key))
 		{
-			for (int i = 0; i < word.size(); i++)
-			{
-				xstring temp(word);
-				xstring del = temp.erase(i, 1);
-				if (deleteWords->insert(del).second)
-				{
-					//recursion, if maximum edit distance not yet reached
-					if (editDistance < maxDictionaryEditDistance) Edits(del, editDistance, deleteWords);
-				}
-			}
+			static thread_local u32string codePoints;
+			Utf8::Decode(key, codePoints);
+			CharEditHashes(u32string_view(codePoints), prefixHashes, editHashes);
+			return;
 		}
-		return deleteWords;
+#endif
+		CharEditHashes(key, prefixHashes, editHashes);
 	}
 
-	HashSet<xstring> SymSpell::EditsPrefix(xstring key)
+	template <class Char>
+	void SymSpell::CharEditHashes(basic_string_view<Char> key, PrefixHashes& prefixHashes, vector<int>& editHashes) const
 	{
-		HashSet<xstring> hashSet = HashSet<xstring>();
-		if (key.size() <= maxDictionaryEditDistance) hashSet.insert(XL(""));
-		if (key.size() > prefixLength) key = key.substr(0, prefixLength);
-		hashSet.insert(key);
-		Edits(key, 0, &hashSet);
-		return hashSet;
+		editHashes.clear();
+		if ((int)key.size() <= maxDictionaryEditDistance) editHashes.push_back(GetHash(0, 0));
+		if ((int)key.size() > prefixLength) key = key.substr(0, prefixLength);
+		prefixHashes.Assign(key);
+		editHashes.push_back(GetHash(prefixHashes.Substring(0, (int)key.size()), (int)key.size()));
+		Edits(prefixHashes, 0, 0, 0, editHashes);
+		// the same delete may be reached by deleting different chars, e.g. either 'l' of "hello"
+		sort(editHashes.begin(), editHashes.end());
+		editHashes.erase(unique(editHashes.begin(), editHashes.end()), editHashes.end());
 	}
 
-	int SymSpell::GetstringHash(xstring s)
+	//add the hashes of all deletes of chars at from or later, where kept is the hash of the chars kept before from
+	void SymSpell::Edits(const PrefixHashes& prefixHashes, int from, int editDistance, uint64_t kept, vector<int>& editHashes) const
 	{
-		//return s.GetHashCode();
+		editDistance++;
+		int len = prefixHashes.Size();
+		//deletes are at least one char long, as in the recursion over delete strings
+		if (len - editDistance < 1) return;
+		for (int i = from; i < len; i++)
+		{
+			uint64_t head = kept * prefixHashes.Power(i - from) + prefixHashes.Substring(from, i);
+			uint64_t hash = head * prefixHashes.Power(len - 1 - i) + prefixHashes.Substring(i + 1, len);
+			editHashes.push_back(GetHash(hash, len - editDistance));
+			//recursion, if maximum edit distance not yet reached
+			if (editDistance < maxDictionaryEditDistance) Edits(prefixHashes, i + 1, editDistance, head, editHashes);
+		}
+	}
 
-		int len = s.size();
+	//hash of a string of length len with the polynomial hash PrefixHashes::Of(string)
+	int SymSpell::GetHash(uint64_t polynomial, int len) const
+	{
 		int lenMask = len;
 		if (lenMask > 3) lenMask = 3;
 
-		uint hash = 2166136261;
-		for (auto i = 0; i < len; i++)
-		{
-			//unchecked, its fine even if it can be overflowed
-			{
-				hash ^= s[i];
-				hash *= 16777619;
-			}
-		}
+		//mix the high bits of the polynomial hash, which depend on every char, into the 32-bit hash
+		polynomial ^= polynomial >> 29;
+		uint hash = (uint)((polynomial * 0xBF58476D1CE4E5B9ULL) >> 32);
 
 		hash &= this->compactMask;
 		hash |= (uint)lenMask;
 		return (int)hash;
 	}
 
+	template <class Char>
+	int SymSpell::GetstringHash(basic_string_view<Char> s) const
+	{
+		return GetHash(PrefixHashes::Of(s), (int)s.size());
+	}
+
 
 	//######################
 
@@ -712,7 +1587,7 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 	/// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
 	/// <param name="input">The string being spell checked.</param>																										   
 	/// <returns>A vector of SuggestItem object representing suggested correct spellings for the input string.</returns> 
-	vector<SuggestItem> SymSpell::LookupCompound(xstring input)
+	vector<SuggestItem> SymSpell::LookupCompound(xstring input) const
 	{
 		return LookupCompound(input, this->maxDictionaryEditDistance);
 	}
@@ -721,25 +1596,38 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 	/// <param name="input">The string being spell checked.</param>
 	/// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>																											   
 	/// <returns>A vector of SuggestItem object representing suggested correct spellings for the input string.</returns> 
-	vector<SuggestItem> SymSpell::LookupCompound(xstring input, int editDistanceMax)
+	vector<SuggestItem> SymSpell::LookupCompound(xstring input, int editDistanceMax) const
 	{
+		QueryStats queryStats;
+		StatsRecorder recorder(this->stats.get(), LookupCompoundQuery, queryStats);
+		PhaseTimer timer(queryStats, CompoundTime);
+		LookupCacheKey key = { LookupCacheKey::LookupCompound, input, Top, editDistanceMax, false };
+		vector<SuggestItem> suggestionsLine;
+		if (this->cache && this->cache->Get(key, this->generation, suggestionsLine)) return suggestionsLine;
+
 		//parse input string into single terms
-		vector<xstring> termList1 = ParseWords(input);
+		vector<xstring_view> termList1 = ParseWords(input);
 
 		vector<SuggestItem> suggestions;     //suggestions for a single term
 		vector<SuggestItem> suggestionParts; //1 line with separate parts
 		auto distanceComparer = EditDistance(this->distanceAlgorithm);
+		vector<int> splitOffsets;
 
 		//translate every term to its best suggestion, otherwise it remains unchanged
 		bool lastCombi = false;
 		for (int i = 0; i < termList1.size(); i++)
 		{
-			suggestions = Lookup(termList1[i], Top, editDistanceMax);
+			{
+				PhaseTimer termTimer(queryStats, CompoundTermLookups);
+				suggestions = Lookup(xstring(termList1[i]), Top, editDistanceMax);
+			}
+			int termLength = CharCount(termList1[i]);
 
 			//combi check, always before split
 			if ((i > 0) && !lastCombi)
 			{
-				vector<SuggestItem> suggestionsCombi = Lookup(termList1[i - 1] + termList1[i], Top, editDistanceMax);
+				PhaseTimer combineTimer(queryStats, CompoundCombine);
+				vector<SuggestItem> suggestionsCombi = Lookup(xstring(termList1[i - 1]).append(termList1[i]), Top, editDistanceMax);
 
 				if (suggestionsCombi.size() > 0)
 				{
@@ -756,7 +1644,7 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 						//estimated edit distance
 						best2.distance = editDistanceMax + 1;
 						//estimated word occurrence probability P=10 / (N * 10^word length l)
-						best2.count = (long)((double)10 / pow((double)10, (double)best2.term.size())); // 0;
+						best2.count = (long)((double)10 / pow((double)10, (double)CharCount(best2.term))); // 0;
 					}
 
 					//distance1=edit distance between 2 split terms und their best corrections : als comparative value for the combination
@@ -773,7 +1661,7 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 			lastCombi = false;
 
 			//alway split terms without suggestion / never split terms with suggestion ed=0 / never split single char terms
-			if ((suggestions.size() > 0) && ((suggestions[0].distance == 0) || (termList1[i].size() == 1)))
+			if ((suggestions.size() > 0) && ((suggestions[0].distance == 0) || (termLength == 1)))
 			{
 				//choose best suggestion
 				suggestionParts.push_back(suggestions[0]);
@@ -786,12 +1674,15 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 				//add original term 
 				if (suggestions.size() > 0) suggestionSplitBest.set(suggestions[0]);
 
-				if (termList1[i].size() > 1)
+				if (termLength > 1)
 				{
-					for (int j = 1; j < termList1[i].size(); j++)
+					PhaseTimer splitTimer(queryStats, CompoundSplit);
+					//the term is split between chars, or between code points in UTF-8 mode
+					CharOffsets(termList1[i], splitOffsets);
+					for (int j = 1; j < termLength; j++)
 					{
-						xstring part1 = termList1[i].substr(0, j);
-						xstring part2 = termList1[i].substr(j);
+						xstring part1(termList1[i].substr(0, splitOffsets[j]));
+						xstring part2(termList1[i].substr(splitOffsets[j]));
 						SuggestItem suggestionSplit = SuggestItem();
 						vector<SuggestItem> suggestions1 = Lookup(part1, Top, editDistanceMax);
 						if (suggestions1.size() > 0)
@@ -802,7 +1693,7 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 								//select best suggestion for split pair
 								suggestionSplit.term = suggestions1[0].term + XL(" ") + suggestions2[0].term;
 
-								int distance2 = distanceComparer.Compare(termList1[i], suggestionSplit.term, editDistanceMax);
+								int distance2 = Compare(distanceComparer, termList1[i], suggestionSplit.term, editDistanceMax);
 								if (distance2 < 0) distance2 = editDistanceMax + 1;
 
 								if (suggestionSplitBest.count)
@@ -813,10 +1704,10 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 
 								suggestionSplit.distance = distance2;
 								//if bigram exists in bigram dictionary
-								if (bigrams.count(suggestionSplit.term))
+								int64_t bigramCount;
+								if (bigrams.Find(suggestions1[0].term, suggestions2[0].term, bigramCount))
 								{
-									long bigramCount = bigrams.at(suggestionSplit.term);
-									suggestionSplit.count = bigramCount;
+									suggestionSplit.count = (long)bigramCount;
 
 									//increase count, if split.corrections are part of or identical to input  
 									//single term correction exists
@@ -863,7 +1754,7 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 						SuggestItem si = SuggestItem();
 						si.term = termList1[i];
 						//estimated word occurrence probability P=10 / (N * 10^word length l)
-						si.count = (long)((double)10 / pow((double)10, (double)si.term.size()));
+						si.count = (long)((double)10 / pow((double)10, (double)termLength));
 						si.distance = editDistanceMax + 1;
 						suggestionParts.push_back(si);
 					}
@@ -873,7 +1764,7 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 					SuggestItem si = SuggestItem();
 					si.term = termList1[i];
 					//estimated word occurrence probability P=10 / (N * 10^word length l)
-					si.count = (long)((double)10 / pow((double)10, (double)si.term.size()));
+					si.count = (long)((double)10 / pow((double)10, (double)termLength));
 					si.distance = editDistanceMax + 1;
 					suggestionParts.push_back(si);
 				}
@@ -893,10 +1784,10 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 		suggestion.count = (long)count;
 		rtrim(s);
 		suggestion.term = s;
-		suggestion.distance = distanceComparer.Compare(input, suggestion.term, MAXINT);
+		suggestion.distance = Compare(distanceComparer, input, suggestion.term, MAXINT);
 
-		vector<SuggestItem> suggestionsLine;
 		suggestionsLine.push_back(suggestion);
+		if (this->cache) this->cache->Put(key, this->generation, suggestionsLine);
 		return suggestionsLine;
 	}
 
@@ -906,7 +1797,7 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 	/// the word segmented and spelling corrected string, 
 	/// the Edit distance sum between input string and corrected string, 
 	/// the Sum of word occurence probabilities in log scale (a measure of how common and probable the corrected segmentation is).</returns> 
-	Info SymSpell::WordSegmentation(xstring input)
+	Info SymSpell::WordSegmentation(xstring input) const
 	{
 		return WordSegmentation(input, this->MaxDictionaryEditDistance(), this->maxDictionaryWordLength);
 	}
@@ -919,7 +1810,7 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 	/// the word segmented and spelling corrected string, 
 	/// the Edit distance sum between input string and corrected string, 
 	/// the Sum of word occurence probabilities in log scale (a measure of how common and probable the corrected segmentation is).</returns> 
-	Info SymSpell::WordSegmentation(xstring input, int maxEditDistance)
+	Info SymSpell::WordSegmentation(xstring input, int maxEditDistance) const
 	{
 		return WordSegmentation(input, maxEditDistance, this->maxDictionaryWordLength);
 	}
@@ -933,92 +1824,154 @@ vector<SuggestItem> SymSpell::Lookup(xstring input, Verbosity verbosity, int max
 	/// the word segmented and spelling corrected string, 
 	/// the Edit distance sum between input string and corrected string, 
 	/// the Sum of word occurence probabilities in log scale (a measure of how common and probable the corrected segmentation is).</returns> 
-	Info SymSpell::WordSegmentation(xstring input, int maxEditDistance, int maxSegmentationWordLength)
+	Info SymSpell::WordSegmentation(xstring input, int maxEditDistance, int maxSegmentationWordLength) const
 	{
-		int arraySize = min(maxSegmentationWordLength, (int)input.size());
-		vector<Info> compositions = vector<Info>(arraySize);
-		int circularIndex = -1;
+		if (maxSegmentationWordLength < 1) throw std::invalid_argument("maxSegmentationWordLength");
+		QueryStats queryStats;
+		StatsRecorder recorder(this->stats.get(), WordSegmentationQuery, queryStats);
+		PhaseTimer timer(queryStats, SegmentationTime);
+		//positions are those of chars, or of code points in UTF-8 mode
+		vector<int> offsets;
+		CharOffsets(input, offsets);
+		int inputLen = (int)offsets.size() - 1;
+		//the input without whitespace, and for every input position its offset in compact and the number of non-whitespace chars before it,
+		//so that a part without whitespace is a view of compact, and the number of removed spaces is known
+		xstring compact;
+		compact.reserve(input.size());
+		vector<int> compactPosition(inputLen + 1);
+		vector<int> compactLength(inputLen + 1);
+		int compactChars = 0;
+		for (int k = 0; k < inputLen; k++)
+		{
+			compactPosition[k] = compact.size();
+			compactLength[k] = compactChars;
+			if (!isxspace(input[offsets[k]]))
+			{
+				compact.append(input, offsets[k], offsets[k + 1] - offsets[k]);
+				compactChars++;
+			}
+		}
+		compactPosition[inputLen] = compact.size();
+		compactLength[inputLen] = compactChars;
+
+		//top spelling correction of the parts starting at the current compact position, by part length:
+		//the parts starting at whitespace and at the following chars are the same, and are looked up once
+		struct PartResult
+		{
+			bool known;
+			int distance;
+			double probabilityLog;
+			xstring term;
+		};
+		vector<PartResult> partResults(maxSegmentationWordLength + 1);
+		int partResultsStart = -1;
+		LookupContext context;
+		vector<SuggestItem> results;
+
+		//best composition of the input up to every end position, as edit distance sum and probability,
+		//and the start and the correction of its last word, to be materialized once at the end
+		vector<int> distances(inputLen + 1);
+		vector<double> probabilities(inputLen + 1);
+		vector<int> starts(inputLen + 1, -1);
+		vector<xstring> terms(inputLen + 1);
 
 		//outer loop (column): all possible part start positions
-		for (int j = 0; j < input.size(); j++)
+		for (int j = 0; j < inputLen; j++)
 		{
 			//inner loop (row): all possible part lengths (from start position): part can't be bigger than longest word in dictionary (other than long unknown word)
-			int imax = min((int)input.size() - j, maxSegmentationWordLength);
+			int imax = min(inputLen - j, maxSegmentationWordLength);
+			if (compactPosition[j] != partResultsStart)
+			{
+				partResultsStart = compactPosition[j];
+				for (PartResult& partResult : partResults) partResult.known = false;
+			}
 			for (int i = 1; i <= imax; i++)
 			{
-				//get top spelling correction/ed for part
-				xstring part = input.substr(j, i);
+				int end = j + i;
+				//get top spelling correction/ed for part, without whitespace
+				xstring_view part(compact.data() + compactPosition[j], compactPosition[end] - compactPosition[j]);
+				int partLength = compactLength[end] - compactLength[j];
 				int separatorLength = 0;
-				int topEd = 0;
+				//a leading space is removed for levensthein calculation, otherwise add ed+1: space did not exist, had to be inserted
+				bool leadingSpace = isxspace(input[offsets[j]]);
+				if (!leadingSpace) separatorLength = 1;
+				//add number of removed spaces (other than a leading one) to topEd
+				int topEd = i - (leadingSpace ? 1 : 0) - partLength;
 				double topProbabilityLog = 0;
-				xstring topResult = XL("");
-
-				if (isxspace(part[0]))
-				{
-					//remove space for levensthein calculation
-					part = part.substr(1);
-				}
-				else
-				{
-					//add ed+1: space did not exist, had to be inserted
-					separatorLength = 1;
-				}
 
-				//remove space from part1, add number of removed spaces to topEd                
-				topEd += part.size();
-				//remove space
-				xregex r(XL("(\\s)+"));
-				part = regex_replace(part, r, XL(""));
-				// part = part.Replace(" ", ""); //=System.Text.RegularExpressions.Regex.Replace(part1, @"\s+", "");
-				// 							  //add number of removed spaces to ed
-				topEd -= part.size();
-
-				vector<SuggestItem> results = this->Lookup(part, Top, maxEditDistance);
-				if (results.size() > 0)
-				{
-					topResult = results[0].term;
-					topEd += results[0].distance;
-					//Naive Bayes Rule
-					//we assume the word probabilities of two words to be independent
-					//therefore the resulting probability of the word combination is the product of the two word probabilities
-
-					//instead of computing the product of probabilities we are computing the sum of the logarithm of probabilities
-					//because the probabilities of words are about 10^-10, the product of many such small numbers could exceed (underflow) the floating number range and become zero
-					//log(ab)=log(a)+log(b)
-					topProbabilityLog = log10((double)results[0].count / (double)N);
-				}
-				else
+				PartResult& partResult = partResults[partLength];
+				if (!partResult.known)
 				{
-					topResult = part;
-					//default, if word not found
-					//otherwise long input text would win as long unknown word (with ed=edmax+1 ), although there there should many spaces inserted 
-					topEd += part.size();
-					topProbabilityLog = log10(10.0 / (N * pow(10.0, part.size())));
+					{
+						PhaseTimer lookupTimer(queryStats, SegmentationLookups);
+						this->Lookup(part, Top, maxEditDistance, false, context, results);
+					}
+					partResult.known = true;
+					if (results.size() > 0)
+					{
+						partResult.term = results[0].term;
+						partResult.distance = results[0].distance;
+						//Naive Bayes Rule
+						//we assume the word probabilities of two words to be independent
+						//therefore the resulting probability of the word combination is the product of the two word probabilities
+
+						//instead of computing the product of probabilities we are computing the sum of the logarithm of probabilities
+						//because the probabilities of words are about 10^-10, the product of many such small numbers could exceed (underflow) the floating number range and become zero
+						//log(ab)=log(a)+log(b)
+						partResult.probabilityLog = log10((double)results[0].count / (double)N);
+					}
+					else
+					{
+						//default, if word not found
+						//otherwise long input text would win as long unknown word (with ed=edmax+1 ), although there there should many spaces inserted 
+						partResult.term.assign(part);
+						partResult.distance = partLength;
+						partResult.probabilityLog = log10(10.0 / (N * pow(10.0, partLength)));
+					}
 				}
+				topEd += partResult.distance;
+				topProbabilityLog = partResult.probabilityLog;
 
-				int destinationIndex = ((i + circularIndex) % arraySize);
-
-				//set values in first loop
-				if (j == 0)
+				//set values in first loop, and the first time a later end is reached
+				if (j == 0 || starts[end] < 0)
 				{
-					compositions[destinationIndex].set(part, topResult, topEd, topProbabilityLog);
+					distances[end] = j == 0 ? topEd : distances[j] + separatorLength + topEd;
+					probabilities[end] = j == 0 ? topProbabilityLog : probabilities[j] + topProbabilityLog;
+					starts[end] = j;
+					terms[end] = partResult.term;
 				}
-				else if ((i == maxSegmentationWordLength)
-					//replace values if better probabilityLogSum, if same edit distance OR one space difference 
-					|| (((compositions[circularIndex].getDistance() + topEd == compositions[destinationIndex].getDistance()) \
-					|| (compositions[circularIndex].getDistance() + separatorLength + topEd == compositions[destinationIndex].getDistance())) \
-					&& (compositions[destinationIndex].getProbability() < compositions[circularIndex].getProbability() + topProbabilityLog))
+				//replace values if better probabilityLogSum, if same edit distance OR one space difference 
+				else if ((((distances[j] + topEd == distances[end])
+					|| (distances[j] + separatorLength + topEd == distances[end]))
+					&& (probabilities[end] < probabilities[j] + topProbabilityLog))
 					//replace values if smaller edit distance     
-					|| (compositions[circularIndex].getDistance() + separatorLength + topEd < compositions[destinationIndex].getDistance()))
+					|| (distances[j] + separatorLength + topEd < distances[end]))
 				{
-					xstring seg = compositions[circularIndex].getSegmented()+ XL(" ") + part;
-					xstring correct = compositions[circularIndex].getCorrected() + XL(" ") + topResult;
-					int d = compositions[circularIndex].getDistance() + separatorLength + topEd;
-					double prob = compositions[circularIndex].getProbability() + topProbabilityLog;
-					compositions[destinationIndex].set(seg, correct, d, prob);
+					distances[end] = distances[j] + separatorLength + topEd;
+					probabilities[end] = probabilities[j] + topProbabilityLog;
+					starts[end] = j;
+					terms[end] = partResult.term;
 				}
 			}
-			circularIndex++; if (circularIndex == arraySize) circularIndex = 0;
 		}
-		return compositions[circularIndex];
+
+		//follow the last words back from the end of the input, then join them
+		vector<int> ends;
+		for (int end = inputLen; end > 0; end = starts[end]) ends.push_back(end);
+		xstring segmented, corrected;
+		for (auto it = ends.rbegin(); it != ends.rend(); ++it)
+		{
+			int end = *it, start = starts[end];
+			xstring_view part(compact.data() + compactPosition[start], compactPosition[end] - compactPosition[start]);
+			if (start > 0)
+			{
+				segmented.push_back(XL(' '));
+				corrected.push_back(XL(' '));
+			}
+			segmented.append(part);
+			corrected.append(terms[end]);
+		}
+		Info composition;
+		composition.set(segmented, corrected, distances[inputLen], probabilities[inputLen]);
+		return composition;
 	}
\ No newline at end of file
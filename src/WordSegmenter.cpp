@@ -0,0 +1,305 @@
+#include "WordSegmenter.h"
+
+/// <summary>Create a new segmenter.</summary>
+/// <param name="symSpell">The dictionary, which must outlive the segmenter.</param>
+/// <param name="maxEditDistance">The maximum edit distance between input and corrected words
+/// (0=no correction/segmentation only).</param>
+/// <param name="maxSegmentationWordLength">The maximum word length that should be considered.</param>
+WordSegmenter::WordSegmenter(const SymSpell& symSpell, int maxEditDistance, int maxSegmentationWordLength)
+	: symSpell(symSpell), maxEditDistance(maxEditDistance), maxSegmentationWordLength(maxSegmentationWordLength)
+{
+	if (maxEditDistance > symSpell.MaxDictionaryEditDistance()) throw std::invalid_argument("maxEditDistance");
+	if (maxSegmentationWordLength < 1) throw std::invalid_argument("maxSegmentationWordLength");
+	row.resize(maxSegmentationWordLength + 1);
+	Reset();
+}
+
+/// <summary>Create a new segmenter, considering words up to the length of the longest dictionary word.</summary>
+WordSegmenter::WordSegmenter(const SymSpell& symSpell, int maxEditDistance)
+	: WordSegmenter(symSpell, maxEditDistance, symSpell.MaxLength())
+{
+}
+
+//start a new text, keeping the words that were not taken yet
+void WordSegmenter::Reset()
+{
+	positions.clear();
+	compact.clear();
+	pending.clear();
+	base = length = column = committed = lastCommitCheck = 0;
+	finished = false;
+	committedDistance = 0;
+	committedProbabilityLog = 0;
+	rowStart = -1;
+	Position start = Position();
+	start.reached = true;
+	start.valid = true;
+	positions.push_back(start);
+}
+
+//the input from start to end, without whitespace
+xstring_view WordSegmenter::Part(int64_t start, int64_t end)
+{
+	int first = At(start).compactPosition;
+	return xstring_view(compact.data() + first, At(end).compactPosition - first);
+}
+
+/// <summary>Append a chunk of the text.</summary>
+/// <remarks>In UTF-8 mode, a chunk may end within the sequence of a code point.</remarks>
+void WordSegmenter::Push(xstring_view chunk)
+{
+	if (finished) Reset();
+#ifndef UNICODE_SUPPORT
+	if (symSpell.Utf8Mode())
+	{
+		pending.append(chunk);
+		const char* end = pending.data() + pending.size();
+		const char* p = pending.data();
+		char32_t codePoint;
+		for (int n; p != end && (n = Utf8::Next(p, end, codePoint)) != 0; p += n) Append(xstring_view(p, n));
+		pending.erase(0, p - pending.data());
+		return;
+	}
+#endif
+	for (size_t i = 0; i < chunk.size(); i++) Append(chunk.substr(i, 1));
+}
+
+//append the next char, or the sequence of the next code point in UTF-8 mode
+void WordSegmenter::Append(xstring_view c)
+{
+	At(length).c = c[0];
+	Position next = Position();
+	next.compactPosition = At(length).compactPosition;
+	next.compactLength = At(length).compactLength;
+	next.valid = true;
+	if (!isxspace(c[0]))
+	{
+		compact.append(c);
+		next.compactPosition += (int)c.size();
+		next.compactLength++;
+	}
+	positions.push_back(next);
+	length++;
+
+	//a start position is processed once all parts starting there are known
+	while (column + maxSegmentationWordLength <= length) ProcessColumn();
+	if (column - lastCommitCheck >= maxSegmentationWordLength)
+	{
+		lastCommitCheck = column;
+		CommitFinal();
+		if (column - committed > 3 * (int64_t)maxSegmentationWordLength) ForceCommit();
+		Trim();
+	}
+}
+
+/// <summary>Mark the end of the text, so that its last words are committed. The next Push starts a new text.</summary>
+void WordSegmenter::Finish()
+{
+	if (finished) Reset();
+#ifndef UNICODE_SUPPORT
+	//a sequence cut short by the end of the text is malformed, and its bytes are code points of their own
+	const char* end = pending.data() + pending.size();
+	char32_t codePoint;
+	for (const char* p = pending.data(); p != end; )
+	{
+		int n = Utf8::Decode(p, end, codePoint);
+		Append(xstring_view(p, n));
+		p += n;
+	}
+	pending.clear();
+#endif
+	while (column < length) ProcessColumn();
+	if (length > committed) Commit(length);
+	finished = true;
+}
+
+//try the part from start to end as the last word of the segmentation up to end, the same way as WordSegmentation
+void WordSegmenter::Relax(int64_t start, int64_t end, PartResult& partResult)
+{
+	//get top spelling correction/ed for part, without whitespace
+	xstring_view part = Part(start, end);
+	//a leading space is removed for levensthein calculation, otherwise add ed+1: space did not exist, had to be inserted
+	bool leadingSpace = isxspace(At(start).c);
+	int separatorLength = leadingSpace ? 0 : 1;
+	//add number of removed spaces (other than a leading one) to topEd
+	int partLength = PartLength(start, end);
+	int topEd = (int)(end - start) - (leadingSpace ? 1 : 0) - partLength;
+
+	if (!partResult.known)
+	{
+		symSpell.Lookup(part, Top, maxEditDistance, false, context, results);
+		partResult.known = true;
+		partResult.found = results.size() > 0;
+		if (partResult.found)
+		{
+			partResult.term = results[0].term;
+			partResult.distance = results[0].distance;
+			partResult.probabilityLog = log10((double)results[0].count / (double)SymSpell::N);
+		}
+		else
+		{
+			partResult.distance = partLength;
+			partResult.probabilityLog = log10(10.0 / (SymSpell::N * pow(10.0, partLength)));
+		}
+	}
+	topEd += partResult.distance;
+	double topProbabilityLog = partResult.probabilityLog;
+
+	Position& source = At(start);
+	Position& target = At(end);
+	int distance = start == 0 ? topEd : source.distance + separatorLength + topEd;
+	double probabilityLog = start == 0 ? topProbabilityLog : source.probabilityLog + topProbabilityLog;
+	//set values the first time end is reached
+	if (start == 0 || !target.reached
+		//replace values if better probabilityLogSum, if same edit distance OR one space difference 
+		|| (((source.distance + topEd == target.distance) || (distance == target.distance)) && (target.probabilityLog < probabilityLog))
+		//replace values if smaller edit distance     
+		|| (distance < target.distance))
+	{
+		target.reached = true;
+		target.distance = distance;
+		target.probabilityLog = probabilityLog;
+		target.start = start;
+		target.found = partResult.found;
+		if (partResult.found) target.term = partResult.term; else target.term.clear();
+	}
+}
+
+//try all parts from the next start position
+void WordSegmenter::ProcessColumn()
+{
+	Position& start = At(column);
+	if (start.compactPosition != rowStart)
+	{
+		rowStart = start.compactPosition;
+		for (PartResult& partResult : row) partResult.known = false;
+	}
+	if (start.reached && start.valid)
+	{
+		int64_t imax = min(length - column, (int64_t)maxSegmentationWordLength);
+		for (int64_t i = 1; i <= imax; i++) Relax(column, column + i, row[PartLength(column, column + i)]);
+	}
+	column++;
+}
+
+//commit the words of the segmentation up to position
+void WordSegmenter::Commit(int64_t position)
+{
+	ends.clear();
+	for (int64_t end = position; end > committed; end = At(end).start) ends.push_back(end);
+	for (auto it = ends.rbegin(); it != ends.rend(); ++it)
+	{
+		Position& end = At(*it);
+		SegmentedWord word;
+		word.segmented.assign(Part(end.start, *it));
+		if (end.found) word.corrected = end.term; else word.corrected = word.segmented;
+		words.push_back(std::move(word));
+	}
+	committed = position;
+	committedDistance = At(position).distance;
+	committedProbabilityLog = At(position).probabilityLog;
+}
+
+//commit the words all later segmentations build on: later words start at a position within the last
+//maxSegmentationWordLength chars, so the words on which the segmentations of all those positions agree are final
+void WordSegmenter::CommitFinal()
+{
+	int64_t first = max(committed, column - maxSegmentationWordLength + 1);
+	visits.assign((size_t)(column - committed + 1), 0);
+	int chains = 0;
+	for (int64_t position = first; position <= column; position++)
+	{
+		if (!At(position).reached || !At(position).valid) continue;
+		chains++;
+		for (int64_t p = position; ; p = At(p).start)
+		{
+			visits[(size_t)(p - committed)]++;
+			if (p == committed) break;
+		}
+	}
+	for (int64_t position = column; position > committed; position--)
+	{
+		if (visits[(size_t)(position - committed)] == chains)
+		{
+			Commit(position);
+			return;
+		}
+	}
+}
+
+//too many chars are undecided: commit the words of the best segmentation up to the current position,
+//and drop the segmentations that do not build on them
+void WordSegmenter::ForceCommit()
+{
+	int64_t limit = column - maxSegmentationWordLength;
+	int64_t position = column;
+	while (position > limit) position = At(position).start;
+	if (position <= committed) return;
+	Commit(position);
+
+	auto buildsOnCommitted = [this](const Position& p) { return p.start == committed || (p.start > committed && At(p.start).valid); };
+	for (int64_t p = committed + 1; p <= column; p++)
+	{
+		Position& end = At(p);
+		end.valid = end.reached && end.valid && buildsOnCommitted(end);
+	}
+	//segmentations of positions after the current one, that were found from dropped start positions, are found again
+	for (int64_t e = column + 1; e <= length && e < column + maxSegmentationWordLength; e++)
+	{
+		Position& end = At(e);
+		if (!end.reached || buildsOnCommitted(end)) continue;
+		end.reached = false;
+		for (int64_t start = max(committed, e - maxSegmentationWordLength); start < column; start++)
+		{
+			PartResult partResult = PartResult();
+			if (At(start).reached && At(start).valid) Relax(start, e, partResult);
+		}
+	}
+}
+
+//free the positions before the committed words
+void WordSegmenter::Trim()
+{
+	size_t drop = (size_t)(committed - base);
+	if (drop < positions.size() / 2 || drop < 64) return;
+	int compactDrop = positions[drop].compactPosition;
+	int lengthDrop = positions[drop].compactLength;
+	positions.erase(positions.begin(), positions.begin() + drop);
+	compact.erase(0, compactDrop);
+	for (Position& position : positions)
+	{
+		position.compactPosition -= compactDrop;
+		position.compactLength -= lengthDrop;
+	}
+	if (rowStart >= 0) rowStart -= compactDrop;
+	base = committed;
+}
+
+/// <summary>Take the next committed word.</summary>
+/// <param name="word">Receives the word.</param>
+/// <returns>True if there was a committed word that was not taken yet.</returns>
+bool WordSegmenter::Next(SegmentedWord& word)
+{
+	if (words.empty()) return false;
+	word = std::move(words.front());
+	words.pop_front();
+	return true;
+}
+
+/// <summary>Number of committed words that were not taken yet.</summary>
+size_t WordSegmenter::Pending() const
+{
+	return words.size();
+}
+
+/// <summary>The edit distance sum between the input and the corrected words committed so far.</summary>
+int WordSegmenter::DistanceSum() const
+{
+	return committedDistance;
+}
+
+/// <summary>The sum of word occurence probabilities in log scale of the words committed so far.</summary>
+double WordSegmenter::ProbabilityLogSum() const
+{
+	return committedProbabilityLog;
+}